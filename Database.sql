@@ -1,4 +1,9 @@
 -- SQLite compatible schema
+-- Server tự tạo/nâng cấp schema qua migrations.cpp (phiên bản lưu trong PRAGMA user_version)
+-- và bật các PRAGMA sau cho mọi kết nối:
+--   PRAGMA journal_mode = WAL;
+--   PRAGMA synchronous = NORMAL;
+--   PRAGMA busy_timeout = 5000;
 
 create table if not exists Users (
     UserID INTEGER PRIMARY KEY AUTOINCREMENT,
@@ -14,10 +19,15 @@ create table if not exists Messages (
     ReceiverID INTEGER not null,
     Content TEXT not null,
     SentAt DATETIME default CURRENT_TIMESTAMP,
+    ConversationKey INTEGER, -- (min(SenderID, ReceiverID) << 32) | max(SenderID, ReceiverID)
     foreign key (SenderID) references Users(UserID),
     foreign key (ReceiverID) references Users(UserID)
 );
 
+create index if not exists idx_messages_conversation on Messages (ConversationKey, MessageID);
+create index if not exists idx_messages_receiver on Messages (ReceiverID, MessageID);
+create index if not exists idx_messages_sender on Messages (SenderID, MessageID);
+
 create table if not exists Friendships (
     UserID1 INTEGER not null,
     UserID2 INTEGER not null,
@@ -55,8 +65,31 @@ create table if not exists GroupMessages (
     foreign key (SenderID) references Users(UserID)
 );
 
+create index if not exists idx_groupmessages_group on GroupMessages (GroupID, GroupMessageID);
+
+-- Mốc lũy kế: mọi tin gửi tới UserID có MessageID <= LastDeliveredID đã tới client
+create table if not exists DeliveryState (
+    UserID INTEGER PRIMARY KEY,
+    LastDeliveredID INTEGER not null default 0,
+    foreign key (UserID) references Users(UserID)
+);
+
+-- Mốc đã đọc theo từng hội thoại
+create table if not exists ReadState (
+    UserID INTEGER not null,
+    PeerID INTEGER not null,
+    LastReadID INTEGER not null default 0,
+    primary key (UserID, PeerID),
+    foreign key (UserID) references Users(UserID),
+    foreign key (PeerID) references Users(UserID)
+);
+
 -- register user
 insert into Users (Username, PasswordHash, Status) values ('alice', 'hashed_password_1', 1);
 
 -- login user
 SELECT PasswordHash, UserID FROM Users WHERE Username = 'alice' AND PasswordHash = 'hashed_password_1';
+
+-- Schema trên tương ứng với bước migration cuối cùng trong migrations.cpp; phải tăng cùng
+-- mỗi bước mới, nếu không server sẽ chạy lại các bước đã có (ví dụ "duplicate column")
+PRAGMA user_version = 5;
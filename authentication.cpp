@@ -2,121 +2,155 @@
 #include "header.h"
 #include <QDebug>
 #include <QJsonObject>
-#include <QSqlDatabase>
 #include <QSqlError>
-#include <QSqlQuery>
 #include <QString>
+#include "config.h"
+#include "database.h"
+#include "delivery.h"
+#include "passwordhash.h"
 #include "server.h"
 
 AuthResult registerUser(const QString &username, const QString &password, const std::string &dbName)
 {
     AuthResult result;
-    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "RegisterConnection");
-    db.setDatabaseName(QString::fromStdString(dbName));
-
-    if (!db.open()) {
-        qDebug() << "Failed to open database for registration:" << db.lastError().text();
+    PooledQuery query(dbName,
+                      "insert into Users (Username, PasswordHash, Status) values (:Username, :PasswordHash, 0);");
+    if (!query.isValid()) {
         result.result = false;
         result.message = "Database connection error.";
         return result;
     }
 
-    QSqlQuery query(db);
-    query.prepare(
-        "insert into Users (Username, PasswordHash, Status) values (:Username, :PasswordHash, 0);");
-    query.bindValue(":Username", username);
-    query.bindValue(":PasswordHash", password); // In production, hash the password!
+    query->bindValue(":Username", username);
+    query->bindValue(":PasswordHash", hashPassword(password));
 
-    if (!query.exec()) {
-        qDebug() << "Registration failed:" << query.lastError().text();
-        db.close();
-        QSqlDatabase::removeDatabase("RegisterConnection");
+    if (!query->exec()) {
+        qDebug() << "Registration failed:" << query->lastError().text();
         result.result = false;
         result.message = "Registration failed. Username may already exist.";
         return result;
     }
 
-    int newUserId = query.lastInsertId().toInt();
+    int newUserId = query->lastInsertId().toInt();
+    Server::getInstance()->getFriendGraph().addUser(newUserId, username);
 
-    db.close();
-    QSqlDatabase::removeDatabase("RegisterConnection");
     result.result = true;
     result.message = "Registration successful.";
     result.userId = newUserId;
     return result;
 }
 
-QJsonObject handleRegistration(const QJsonObject &request, SOCKET clientSocket)
+// Trả lời ngay khi auth pool đã đầy thay vì để yêu cầu xếp hàng vô hạn
+static void sendServerBusy(const ConnectionPtr &conn, const char *action)
+{
+    QJsonObject response = {{"action", action},
+                            {"success", false},
+                            {"busy", true},
+                            {"message", "Server is busy, please try again later."}};
+    sendJsonResponse(conn, response);
+}
+
+// Cho kết nối xử lý tiếp các request sau khi việc trên auth pool kết thúc, kể cả khi có ngoại lệ
+struct ResumeRequestsGuard
+{
+    ConnectionPtr conn;
+    ~ResumeRequestsGuard() { Server::getInstance()->resumeRequests(conn); }
+};
+
+// Cấp token phiên để lần kết nối sau dùng resumeSession thay vì gửi lại mật khẩu
+static void addSessionToken(QJsonObject &response, int userId)
+{
+    SessionTokenStore &tokens = Server::getInstance()->getSessionTokens();
+    response["sessionToken"] = tokens.issue(userId);
+    response["expiresIn"] = tokens.ttlSeconds();
+}
+
+QJsonObject handleRegistration(const Request &request, SOCKET clientSocket)
 {
+    ConnectionPtr conn = Server::getInstance()->findConnection(clientSocket);
+    if (!conn) {
+        return {};
+    }
     QString username = request["username"].toString();
     QString password = request["password"].toString();
-    QJsonObject response;
-    AuthResult result = registerUser(username, password, DB_NAME);
-    response = {{"action", "registerResponse"},
-                {"success", result.result},
-                {"message", QString::fromStdString(result.message)},
-                {"userId", result.userId}};
-    sendJsonResponse(clientSocket, response);
-    qDebug() << "Sent registration response to client: " << response["userId"].toInt();
-    if (result.result) {
-        // If registration successful, add user to server's userSockets map
-        Server::getInstance()->addUserToMap(result.userId, clientSocket);
+
+    // Băm mật khẩu tốn CPU nên chạy trên auth pool, worker được trả lại ngay.
+    // Phản hồi gửi qua conn nên không nhầm sang kết nối khác dù socket đã đóng.
+    // Các request sau của kết nối chờ cho tới khi phiên đã được gán.
+    Server::getInstance()->parkRequests(*conn);
+    bool accepted = Server::getInstance()->submitAuthTask([conn, username, password] {
+        ResumeRequestsGuard resume{conn};
+        AuthResult result = registerUser(username, password, DB_NAME);
+        QJsonObject response = {{"action", "registerResponse"},
+                                 {"success", result.result},
+                                 {"message", QString::fromStdString(result.message)},
+                                 {"userId", result.userId}};
+        if (result.result) {
+            addSessionToken(response, result.userId);
+        }
+        sendJsonResponse(conn, response);
+        qDebug() << "Sent registration response to client: " << result.userId;
+        if (result.result) {
+            // If registration successful, register the session in the server's presence registry
+            Server::getInstance()->addUserToMap(result.userId, conn);
+        }
+    });
+    if (!accepted) {
+        Server::getInstance()->resumeRequests(conn);
+        sendServerBusy(conn, "registerResponse");
     }
-    return response;
+    return {};
 }
 
 AuthResult loginUser(const QString &username, const QString &password, const std::string &dbName)
 {
-    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "LoginConnection");
-    db.setDatabaseName(QString::fromStdString(dbName));
     AuthResult result;
-    if (!db.open()) {
-        qDebug() << "Failed to open database for login:" << db.lastError().text();
+    PooledQuery query(dbName, "select UserID, PasswordHash from Users where Username = :Username;");
+    if (!query.isValid()) {
         result.result = false;
         result.message = "Database connection error.";
         return result;
     }
 
-    QSqlQuery query(db);
-    query.prepare("select UserID, PasswordHash from Users where Username = :Username;");
-    query.bindValue(":Username", username);
+    query->bindValue(":Username", username);
 
-    if (!query.exec()) {
-        qDebug() << "Login query failed:" << query.lastError().text();
-        db.close();
-        QSqlDatabase::removeDatabase("LoginConnection");
+    if (!query->exec()) {
+        qDebug() << "Login query failed:" << query->lastError().text();
         result.result = false;
         result.message = "Login failed due to query error.";
         return result;
     }
 
-    if (query.next()) {
-        int userId = query.value(0).toInt();
-        QString storedPasswordHash = query.value(1).toString();
-        bool loginSuccess = storedPasswordHash == password;
+    if (query->next()) {
+        int userId = query->value(0).toInt();
+        QString storedPasswordHash = query->value(1).toString();
+        query->finish();
+        bool needsRehash = false;
+        bool loginSuccess = verifyPassword(password, storedPasswordHash, needsRehash);
         if (loginSuccess) {
-            // udate user status to online
-            QSqlQuery updateQuery(db);
-            updateQuery.prepare("update Users set Status = 1 where Username = :Username;");
-            updateQuery.bindValue(":Username", username);
-            if (!updateQuery.exec()) {
-                qDebug() << "Failed to update user status:" << updateQuery.lastError().text();
+            if (needsRehash) {
+                // Nâng cấp mật khẩu thô (hoặc số vòng cũ) lên hash hiện tại
+                PooledQuery updateQuery(dbName, "update Users set PasswordHash = :PasswordHash where UserID = :UserID;");
+                if (updateQuery.isValid()) {
+                    updateQuery->bindValue(":PasswordHash", hashPassword(password));
+                    updateQuery->bindValue(":UserID", userId);
+                    if (!updateQuery->exec()) {
+                        qDebug() << "Failed to upgrade password hash:" << updateQuery->lastError().text();
+                    }
+                }
             }
+            // Trạng thái online chỉ giữ trong bộ nhớ, handleLogin gọi addUserToMap
             qDebug() << "User logged in successfully:" << username;
             result.userId = userId;
 
         } else {
             qDebug() << "Incorrect password for user:" << username;
         }
-        db.close();
-        QSqlDatabase::removeDatabase("LoginConnection");
         result.result = loginSuccess;
         result.message = loginSuccess ? "Đăng nhập thành công." : "Tên đăng nhập hoặc mật khẩu không đúng.";
         return result;
     } else {
         qDebug() << "Username not found during login.";
-        db.close();
-        QSqlDatabase::removeDatabase("LoginConnection");
         result.result = false;
         result.message = "Tên đăng nhập có thể không tồn tại.";
         return result;
@@ -124,57 +158,118 @@ AuthResult loginUser(const QString &username, const QString &password, const std
     return result;
 }
 
-QJsonObject handleLogin(const QJsonObject &request, SOCKET clientSocket)
+QJsonObject handleLogin(const Request &request, SOCKET clientSocket)
 {
+    ConnectionPtr conn = Server::getInstance()->findConnection(clientSocket);
+    if (!conn) {
+        return {};
+    }
     QString username = request["username"].toString();
     QString password = request["password"].toString();
 
-    AuthResult result = loginUser(username, password, DB_NAME);
-    QJsonObject response = {{"action", "loginResponse"},
-                            {"success", result.result},
-                            {"message", QString::fromStdString(result.message)},
-                            {"userId", result.userId}};
+    Server::getInstance()->parkRequests(*conn);
+    bool accepted = Server::getInstance()->submitAuthTask([conn, username, password] {
+        ResumeRequestsGuard resume{conn};
+        AuthResult result = loginUser(username, password, DB_NAME);
+        QJsonObject response = {{"action", "loginResponse"},
+                                {"success", result.result},
+                                {"message", QString::fromStdString(result.message)},
+                                {"userId", result.userId}};
+        if (result.result) {
+            addSessionToken(response, result.userId);
+        }
+        sendJsonResponse(conn, response);
+        qDebug() << "Sent login response to client: " << result.userId;
+        if (result.result) {
+            // If login successful, register the session in the server's presence registry
+            Server::getInstance()->addUserToMap(result.userId, conn);
+            // Gửi các tin đến trong lúc offline ngay sau phản hồi đăng nhập
+            flushOfflineBacklog(result.userId, conn);
+        }
+    });
+    if (!accepted) {
+        Server::getInstance()->resumeRequests(conn);
+        sendServerBusy(conn, "loginResponse");
+    }
+    return {};
+}
 
-    sendJsonResponse(clientSocket, response);
-    qDebug() << "Sent login response to client: " << response["userId"].toInt();
-    if (result.result) {
-        // If login successful, add user to server's userSockets map
-        Server::getInstance()->addUserToMap(result.userId, clientSocket);
+// Thỏa thuận kiểu mã hóa cho kết nối. Phản hồi gửi bằng kiểu cũ, các frame sau dùng kiểu mới.
+// CBOR là nhị phân nên chỉ dùng được với client gửi frame có header độ dài.
+QJsonObject handleHello(const Request &request, SOCKET clientSocket)
+{
+    ConnectionPtr conn = Server::getInstance()->findConnection(clientSocket);
+    if (!conn) {
+        return {};
     }
+
+    QString requested = request["encoding"].toString();
+    bool cbor = requested == "cbor" && conn->decoder.mode() == FrameMode::LengthPrefixed;
+    bool deliveryAcks = request["deliveryAcks"].toBool();
+    conn->deliveryAcks.store(deliveryAcks);
+    // Báo chu kỳ heartbeat để client biết khi nào phải trả lời "ping"
+    QJsonObject response = {{"action", "helloResponse"},
+                            {"success", true},
+                            {"encoding", cbor ? "cbor" : "json"},
+                            {"deliveryAcks", deliveryAcks},
+                            {"pingIntervalMs", serverConfig().pingIntervalMs},
+                            {"idleTimeoutMs", serverConfig().idleTimeoutMs}};
+    // Phản hồi vẫn mã hóa bằng kiểu cũ; đổi kiểu ngay sau khi nó vào hàng đợi, dưới cùng
+    // khóa gửi, để frame của luồng khác (fan-out, ping) không chen vào giữa với kiểu sai
+    QByteArray payload = encodeMessage(response, conn->encoding.load());
+    conn->sendFrameAndSwitchEncoding(payload, cbor ? WireEncoding::Cbor : WireEncoding::Json);
     return response;
 }
 
-bool logoutUser(const int &userID, const std::string &dbName)
+QJsonObject handleResumeSession(const Request &request, SOCKET clientSocket)
 {
-    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "LogoutConnection");
-    db.setDatabaseName(QString::fromStdString(dbName));
+    ConnectionPtr conn = Server::getInstance()->findConnection(clientSocket);
+    if (!conn) {
+        return {};
+    }
 
-    if (!db.open()) {
-        qDebug() << "Failed to open database for logout:" << db.lastError().text();
-        return false;
+    // Không truy vấn database, không chạy KDF: chỉ tra token trong bộ nhớ
+    int userId = Server::getInstance()->getSessionTokens().validate(request["sessionToken"].toString());
+    QJsonObject response = {{"action", "resumeResponse"}, {"success", userId != -1}, {"userId", userId}};
+    if (userId == -1) {
+        response["message"] = "Session expired, please log in again.";
+        sendJsonResponse(conn, response);
+        return response;
     }
 
-    QSqlQuery query(db);
-    query.prepare("update Users set Status = 0 where UserID = :UserID;");
-    query.bindValue(":UserID", userID);
+    response["message"] = "Session resumed.";
+    response["expiresIn"] = Server::getInstance()->getSessionTokens().ttlSeconds();
+    sendJsonResponse(conn, response);
+    qDebug() << "Resumed session for user" << userId;
+
+    // Khôi phục như một lần đăng nhập: phiên, presence và tin nhắn chờ giao
+    Server::getInstance()->addUserToMap(userId, conn);
+    flushOfflineBacklog(userId, conn);
+    return response;
+}
 
-    if (!query.exec()) {
-        qDebug() << "Logout failed:" << query.lastError().text();
-        db.close();
-        QSqlDatabase::removeDatabase("LogoutConnection");
+bool logoutUser(const int &userID, SOCKET clientSocket)
+{
+    // Chỉ gỡ phiên của kết nối này, các thiết bị khác của người dùng vẫn online
+    if (!Server::getInstance()->removeUserSession(userID, clientSocket)) {
         return false;
     }
-
-    db.close();
-    QSqlDatabase::removeDatabase("LogoutConnection");
     qDebug() << "User logged out successfully:" << userID;
     return true;
 }
 
-QJsonObject handleLogout(const QJsonObject &request, SOCKET clientSocket)
+QJsonObject handleLogout(const Request &request, SOCKET clientSocket)
 {
-    int userId = request["userId"].toInt();
-    bool success = logoutUser(userId, DB_NAME);
+    // Chỉ đăng xuất người dùng của chính kết nối này; unbindUser đặt lại conn->userId
+    int userId = requireSessionUser(clientSocket, "logoutResponse");
+    if (userId == -1) {
+        return {};
+    }
+    bool success = logoutUser(userId, clientSocket);
+    if (request.contains("sessionToken")) {
+        // Đăng xuất hẳn: token này không dùng để resume được nữa
+        Server::getInstance()->getSessionTokens().revoke(request["sessionToken"].toString());
+    }
     QJsonObject response = {{"action", "logoutResponse"},
                             {"success", success},
                             {"message", success ? "Logout successful" : "Logout failed"}};
@@ -182,10 +277,11 @@ QJsonObject handleLogout(const QJsonObject &request, SOCKET clientSocket)
     return response;
 }
 
-void initAuthenticationHandlers(
-    std::map<QString, std::function<QJsonObject(const QJsonObject &, SOCKET)>> &handlers)
+void initAuthenticationHandlers(HandlerTable &handlers)
 {
-    handlers["register"] = handleRegistration;
-    handlers["login"] = handleLogin;
-    handlers["logout"] = handleLogout;
+    handlers.add(Opcode::Register, handleRegistration);
+    handlers.add(Opcode::Login, handleLogin);
+    handlers.add(Opcode::Logout, handleLogout);
+    handlers.add(Opcode::ResumeSession, handleResumeSession);
+    handlers.add(Opcode::Hello, handleHello);
 }
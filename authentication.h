@@ -7,7 +7,8 @@
 #include <map>
 #include <string>
 
-#include <winsock2.h>
+#include "handlertable.h"
+#include "platform.h"
 
 typedef struct
 {
@@ -17,14 +18,13 @@ typedef struct
 } AuthResult;
 
 AuthResult registerUser(const QString &username, const QString &password, const std::string &dbName);
-QJsonObject handleRegistration(const QJsonObject &request, SOCKET clientSocket);
+QJsonObject handleRegistration(const Request &request, SOCKET clientSocket);
 
 AuthResult loginUser(const QString &username, const QString &password, const std::string &dbName);
-QJsonObject handleLogin(const QJsonObject &request, SOCKET clientSocket);
+QJsonObject handleLogin(const Request &request, SOCKET clientSocket);
 
-bool logoutUser(const int &userID, const std::string &dbName);
-// QJsonObject handleLogout(const QJsonObject &request, SOCKET clientSocket);
-void initAuthenticationHandlers(
-    std::map<QString, std::function<QJsonObject(const QJsonObject &, SOCKET)>> &handlers);
+bool logoutUser(const int &userID, SOCKET clientSocket);
+// QJsonObject handleLogout(const Request &request, SOCKET clientSocket);
+void initAuthenticationHandlers(HandlerTable &handlers);
 
 #endif // AUTHENTICATION_H
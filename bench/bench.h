@@ -0,0 +1,57 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <QString>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// Khung benchmark tối giản cho serverBench: mỗi benchmark là một hàm không tham số,
+// tự đăng ký bằng BENCHMARK(tên) và tự in kết quả. Chạy: serverBench [tên...]
+typedef void (*BenchFunction)();
+
+struct BenchRegistrar
+{
+    BenchRegistrar(const char *name, BenchFunction function);
+};
+
+#define BENCHMARK(name)                                             \
+    static void bench_##name();                                     \
+    static BenchRegistrar bench_##name##_registrar(#name, bench_##name); \
+    static void bench_##name()
+
+// Thư mục tạm riêng của lần chạy hiện tại (database, server.ini...)
+QString benchDir();
+
+inline int64_t benchNowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// Chạy fn iterations lần, trả về thời gian trung bình mỗi lần (ns)
+template<typename Fn>
+double measureNs(int iterations, Fn fn)
+{
+    int64_t start = benchNowNs();
+    for (int i = 0; i < iterations; ++i) {
+        fn();
+    }
+    return static_cast<double>(benchNowNs() - start) / iterations;
+}
+
+// Phân vị p (0..1) của các mẫu, samples bị sắp xếp lại
+inline double percentile(std::vector<double> &samples, double p)
+{
+    if (samples.empty()) {
+        return 0;
+    }
+    size_t index = std::min(samples.size() - 1, static_cast<size_t>(p * samples.size()));
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index];
+}
+
+#endif // BENCH_H
@@ -0,0 +1,68 @@
+#include "bench.h"
+#include "codec.h"
+#include <QJsonArray>
+
+// encodeMessage/decodeRequest với JSON so với CBOR: một request sendMessage nhỏ
+// và một trang 20 tin nhắn (phản hồi getMessages), cùng kích thước payload.
+#define CODEC_ITERATIONS 100000
+#define CODEC_PAGE_MESSAGES 20
+
+static QJsonObject sendMessageRequest()
+{
+    QJsonObject request;
+    request["action"] = "sendMessage";
+    request["receiverID"] = 4242;
+    request["content"] = "Hello, this is a fairly ordinary chat message.";
+    request["clientMessageId"] = "c7a1e0d2-0b6f-4d8e-9a41-2f3c5d7e9b10";
+    return request;
+}
+
+static QJsonObject messagePage()
+{
+    QJsonArray messages;
+    for (int i = 0; i < CODEC_PAGE_MESSAGES; ++i) {
+        QJsonObject message;
+        message["messageId"] = static_cast<qint64>(1000000 + i);
+        message["senderID"] = i % 2 ? 17 : 4242;
+        message["receiverID"] = i % 2 ? 4242 : 17;
+        message["content"] = "Hello, this is a fairly ordinary chat message.";
+        message["sentAt"] = "2024-05-01 12:00:00";
+        messages.append(message);
+    }
+    QJsonObject page;
+    page["action"] = "getMessages";
+    page["success"] = true;
+    page["messages"] = messages;
+    page["hasMore"] = true;
+    return page;
+}
+
+static void runCodec(const char *name, const QJsonObject &message)
+{
+    for (WireEncoding encoding : {WireEncoding::Json, WireEncoding::Cbor}) {
+        QByteArray payload;
+        double encodeNs = measureNs(CODEC_ITERATIONS, [&] { payload = encodeMessage(message, encoding); });
+
+        int fields = 0;
+        double decodeNs = measureNs(CODEC_ITERATIONS, [&] {
+            Request request;
+            if (decodeRequest(payload, request)) {
+                fields += request["receiverID"].toInt() != 0;
+                fields += !request["content"].toString().isEmpty();
+            }
+        });
+
+        printf("%-12s %-4s %6d bytes   encode %8.0f ns   decode %8.0f ns\n",
+               name,
+               encoding == WireEncoding::Json ? "json" : "cbor",
+               static_cast<int>(payload.size()),
+               encodeNs,
+               decodeNs);
+    }
+}
+
+BENCHMARK(codec)
+{
+    runCodec("sendMessage", sendMessageRequest());
+    runCodec("messagePage", messagePage());
+}
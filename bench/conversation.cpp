@@ -0,0 +1,118 @@
+#include "bench.h"
+#include "messagewriter.h"
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QVariant>
+#include <random>
+
+// Lấy trang hội thoại trên database có sẵn nhiều tin: truy vấn cũ (OR hai chiều, sắp theo SentAt,
+// không có chỉ mục) so với range scan trên chỉ mục (ConversationKey, MessageID).
+#define CONVERSATION_USERS 1000
+#define CONVERSATION_MESSAGES 1000000
+#define CONVERSATION_QUERIES 200
+
+static bool seedMessages(QSqlDatabase &db)
+{
+    QSqlQuery query(db);
+    if (!query.exec("create table Messages ("
+                    "MessageID INTEGER PRIMARY KEY AUTOINCREMENT,"
+                    "SenderID INTEGER not null,"
+                    "ReceiverID INTEGER not null,"
+                    "Content TEXT not null,"
+                    "SentAt DATETIME default CURRENT_TIMESTAMP,"
+                    "ConversationKey INTEGER);")) {
+        printf("create table failed: %s\n", qPrintable(query.lastError().text()));
+        return false;
+    }
+
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> user(1, CONVERSATION_USERS);
+    db.transaction();
+    query.prepare("insert into Messages (SenderID, ReceiverID, Content, SentAt, ConversationKey) "
+                  "values (?, ?, ?, datetime('now', ?), ?);");
+    for (int i = 0; i < CONVERSATION_MESSAGES; ++i) {
+        int sender = user(random);
+        int receiver = user(random);
+        query.addBindValue(sender);
+        query.addBindValue(receiver);
+        query.addBindValue(QString("benchmark message"));
+        query.addBindValue(QString("-%1 seconds").arg(CONVERSATION_MESSAGES - i));
+        query.addBindValue(conversationKey(sender, receiver));
+        if (!query.exec()) {
+            printf("seed failed: %s\n", qPrintable(query.lastError().text()));
+            db.rollback();
+            return false;
+        }
+    }
+    return db.commit();
+}
+
+// Thời gian trung bình (us) để lấy trang 20 tin của một cặp người dùng ngẫu nhiên
+template<typename Bind>
+static double measurePage(QSqlDatabase &db, const char *sql, Bind bind)
+{
+    QSqlQuery query(db);
+    query.prepare(QString::fromLatin1(sql));
+    std::mt19937 random(7);
+    std::uniform_int_distribution<int> user(1, CONVERSATION_USERS);
+    int rows = 0;
+    double ns = measureNs(CONVERSATION_QUERIES, [&] {
+        bind(query, user(random), user(random));
+        query.exec();
+        while (query.next()) {
+            ++rows;
+        }
+        query.finish();
+    });
+    return ns / 1000.0;
+}
+
+static void runConversation()
+{
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "BenchConversation");
+    db.setDatabaseName(benchDir() + "/conversation.db");
+    if (!db.open()) {
+        printf("cannot open database: %s\n", qPrintable(db.lastError().text()));
+        return;
+    }
+    int64_t seedStart = benchNowNs();
+    if (!seedMessages(db)) {
+        return;
+    }
+    printf("seeded %d messages between %d users in %.1f s\n",
+           CONVERSATION_MESSAGES,
+           CONVERSATION_USERS,
+           static_cast<double>(benchNowNs() - seedStart) / 1e9);
+
+    double before = measurePage(db,
+                                "select SenderID, ReceiverID, Content, SentAt from Messages "
+                                "where (SenderID = :UserID and ReceiverID = :FriendID) "
+                                "or (SenderID = :FriendID and ReceiverID = :UserID) "
+                                "order by SentAt ASC LIMIT 20;",
+                                [](QSqlQuery &query, int userID, int friendID) {
+                                    query.bindValue(":UserID", userID);
+                                    query.bindValue(":FriendID", friendID);
+                                });
+    printf("before (OR + order by SentAt, no index): %10.1f us/page\n", before);
+
+    QSqlQuery index(db);
+    if (!index.exec("create index idx_messages_conversation on Messages (ConversationKey, MessageID);")) {
+        printf("create index failed: %s\n", qPrintable(index.lastError().text()));
+        return;
+    }
+    double after = measurePage(db,
+                               "select MessageID, SenderID, ReceiverID, Content, SentAt from Messages "
+                               "where ConversationKey = :ConversationKey "
+                               "order by MessageID desc LIMIT 20;",
+                               [](QSqlQuery &query, int userID, int friendID) {
+                                   query.bindValue(":ConversationKey", conversationKey(userID, friendID));
+                               });
+    printf("after (ConversationKey, MessageID index): %10.1f us/page (%.0fx)\n", after, before / after);
+}
+
+BENCHMARK(conversation)
+{
+    runConversation();
+    QSqlDatabase::removeDatabase("BenchConversation");
+}
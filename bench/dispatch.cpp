@@ -0,0 +1,174 @@
+#include "bench.h"
+#include "platform.h"
+#include "protocol.h"
+#include "server.h"
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+// Nhiều client đồng thời gửi request qua loopback tới một Server chạy trong tiến trình.
+// Mỗi client giữ DISPATCH_PIPELINE request đang chờ, đo thông lượng và độ trễ từng request.
+#define DISPATCH_PORT 8080
+#define DISPATCH_CLIENTS 32
+#define DISPATCH_REQUESTS_PER_CLIENT 2000
+#define DISPATCH_PIPELINE 8
+
+static SOCKET connectLoopback()
+{
+    SOCKET s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (s == INVALID_SOCKET) {
+        return INVALID_SOCKET;
+    }
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(DISPATCH_PORT);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    if (::connect(s, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == SOCKET_ERROR) {
+        closesocket(s);
+        return INVALID_SOCKET;
+    }
+    int noDelay = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char *>(&noDelay), sizeof(noDelay));
+    return s;
+}
+
+static bool sendAll(SOCKET s, const char *data, size_t len)
+{
+    while (len > 0) {
+        int sent = send(s, data, static_cast<int>(len), SOCKET_SEND_FLAGS);
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        len -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+static bool recvAll(SOCKET s, char *data, size_t len)
+{
+    while (len > 0) {
+        int received = recv(s, data, static_cast<int>(len), 0);
+        if (received <= 0) {
+            return false;
+        }
+        data += received;
+        len -= static_cast<size_t>(received);
+    }
+    return true;
+}
+
+// Bỏ qua payload, chỉ cần biết một phản hồi đã tới
+static bool readFrame(SOCKET s, QByteArray &payload)
+{
+    unsigned char header[FRAME_HEADER_SIZE];
+    if (!recvAll(s, reinterpret_cast<char *>(header), FRAME_HEADER_SIZE)) {
+        return false;
+    }
+    size_t len = (size_t(header[0]) << 24) | (size_t(header[1]) << 16) | (size_t(header[2]) << 8) | header[3];
+    payload.resize(static_cast<qsizetype>(len));
+    return recvAll(s, payload.data(), len);
+}
+
+static QByteArray makeFrame(const QJsonObject &request)
+{
+    QByteArray payload = QJsonDocument(request).toJson(QJsonDocument::Compact);
+    char header[FRAME_HEADER_SIZE];
+    writeFrameHeader(header, static_cast<size_t>(payload.size()));
+    return QByteArray(header, FRAME_HEADER_SIZE) + payload;
+}
+
+static bool startServer()
+{
+    static Server *server = nullptr;
+    if (!server) {
+        // Cố ý không hủy: các luồng reactor của server chạy tới khi tiến trình kết thúc
+        server = new Server();
+        server->startServer();
+    }
+    for (int attempt = 0; attempt < 100; ++attempt) {
+        SOCKET s = connectLoopback();
+        if (s != INVALID_SOCKET) {
+            closesocket(s);
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    return false;
+}
+
+static void runDispatch(const char *label, const QJsonObject &request)
+{
+    const QByteArray frame = makeFrame(request);
+    std::vector<std::vector<double>> latencies(DISPATCH_CLIENTS);
+    std::atomic<int> failures{0};
+
+    int64_t start = benchNowNs();
+    std::vector<std::thread> clients;
+    for (int c = 0; c < DISPATCH_CLIENTS; ++c) {
+        clients.emplace_back([&, c] {
+            SOCKET s = connectLoopback();
+            if (s == INVALID_SOCKET) {
+                failures.fetch_add(1);
+                return;
+            }
+            std::vector<double> &samples = latencies[c];
+            samples.reserve(DISPATCH_REQUESTS_PER_CLIENT);
+            std::vector<int64_t> sentAt(DISPATCH_REQUESTS_PER_CLIENT);
+            QByteArray payload;
+            int sent = 0;
+            for (int done = 0; done < DISPATCH_REQUESTS_PER_CLIENT; ++done) {
+                // Giữ tối đa DISPATCH_PIPELINE request chưa có phản hồi
+                while (sent < DISPATCH_REQUESTS_PER_CLIENT && sent - done < DISPATCH_PIPELINE) {
+                    sentAt[sent] = benchNowNs();
+                    if (!sendAll(s, frame.constData(), static_cast<size_t>(frame.size()))) {
+                        failures.fetch_add(1);
+                        closesocket(s);
+                        return;
+                    }
+                    ++sent;
+                }
+                // Server giữ thứ tự phản hồi trên một kết nối
+                if (!readFrame(s, payload)) {
+                    failures.fetch_add(1);
+                    closesocket(s);
+                    return;
+                }
+                samples.push_back(static_cast<double>(benchNowNs() - sentAt[done]) / 1000.0);
+            }
+            closesocket(s);
+        });
+    }
+    for (std::thread &client : clients) {
+        client.join();
+    }
+    double seconds = static_cast<double>(benchNowNs() - start) / 1e9;
+
+    std::vector<double> all;
+    for (const std::vector<double> &samples : latencies) {
+        all.insert(all.end(), samples.begin(), samples.end());
+    }
+    printf("%-14s %d clients x %d requests: %.0f req/s, p50 %.1f us, p99 %.1f us, failed clients %d\n",
+           label,
+           DISPATCH_CLIENTS,
+           DISPATCH_REQUESTS_PER_CLIENT,
+           all.size() / seconds,
+           percentile(all, 0.50),
+           percentile(all, 0.99),
+           failures.load());
+}
+
+BENCHMARK(dispatch)
+{
+    if (!startServer()) {
+        printf("server did not start on port %d\n", DISPATCH_PORT);
+        return;
+    }
+    // ping chỉ đo đường reactor -> worker -> hàng đợi gửi; searchUsers thêm một truy vấn SQLite
+    runDispatch("ping", {{"action", "ping"}});
+    runDispatch("searchUsers", {{"action", "searchUsers"}, {"query", "a"}, {"pageSize", 20}});
+}
@@ -0,0 +1,182 @@
+#include "bench.h"
+#include "friendgraph.h"
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QVariant>
+#include <random>
+
+// Đọc quan hệ bạn bè: các truy vấn SQL cũ của friend.cpp (mỗi request một truy vấn)
+// so với FriendGraph nạp sẵn trong bộ nhớ, trên cùng một database đã seed.
+#define FRIENDGRAPH_USERS 10000
+#define FRIENDGRAPH_EDGES_PER_USER 20
+#define FRIENDGRAPH_QUERIES 2000
+
+static bool seedFriendships(QSqlDatabase &db)
+{
+    QSqlQuery query(db);
+    if (!query.exec("create table Users ("
+                    "UserID INTEGER PRIMARY KEY AUTOINCREMENT,"
+                    "Username TEXT not null unique);")
+        || !query.exec("create table Friendships ("
+                       "UserID1 INTEGER not null,"
+                       "UserID2 INTEGER not null,"
+                       "RequesterID INTEGER not null,"
+                       "Status INTEGER not null,"
+                       "primary key (UserID1, UserID2));")) {
+        printf("create table failed: %s\n", qPrintable(query.lastError().text()));
+        return false;
+    }
+
+    db.transaction();
+    query.prepare("insert into Users (UserID, Username) values (?, ?);");
+    for (int userId = 1; userId <= FRIENDGRAPH_USERS; ++userId) {
+        query.addBindValue(userId);
+        query.addBindValue(QString("user%1").arg(userId));
+        if (!query.exec()) {
+            printf("seed users failed: %s\n", qPrintable(query.lastError().text()));
+            db.rollback();
+            return false;
+        }
+    }
+
+    // Khoảng 3/4 cạnh là bạn bè, còn lại là lời mời đang chờ
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> user(1, FRIENDGRAPH_USERS);
+    std::uniform_int_distribution<int> status(0, 3);
+    query.prepare("insert or ignore into Friendships (UserID1, UserID2, RequesterID, Status) "
+                  "values (?, ?, ?, ?);");
+    for (int i = 0; i < FRIENDGRAPH_USERS * FRIENDGRAPH_EDGES_PER_USER / 2; ++i) {
+        int from = user(random);
+        int to = user(random);
+        if (from == to) {
+            continue;
+        }
+        query.addBindValue(from);
+        query.addBindValue(to);
+        query.addBindValue(from);
+        query.addBindValue(status(random) == 0 ? 0 : 1);
+        if (!query.exec()) {
+            printf("seed friendships failed: %s\n", qPrintable(query.lastError().text()));
+            db.rollback();
+            return false;
+        }
+    }
+    return db.commit();
+}
+
+// Thời gian trung bình (us) của một truy vấn cũ với cặp người dùng ngẫu nhiên
+template<typename Bind>
+static double measureSql(QSqlDatabase &db, const char *sql, int iterations, Bind bind)
+{
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare(QString::fromLatin1(sql));
+    std::mt19937 random(7);
+    std::uniform_int_distribution<int> user(1, FRIENDGRAPH_USERS);
+    int rows = 0;
+    double ns = measureNs(iterations, [&] {
+        bind(query, user(random), user(random));
+        query.exec();
+        while (query.next()) {
+            ++rows;
+        }
+        query.finish();
+    });
+    return ns / 1000.0;
+}
+
+// Thời gian trung bình (us) của một lần đọc FriendGraph với cặp người dùng ngẫu nhiên
+template<typename Read>
+static double measureGraph(int iterations, Read read)
+{
+    std::mt19937 random(7);
+    std::uniform_int_distribution<int> user(1, FRIENDGRAPH_USERS);
+    size_t items = 0;
+    double ns = measureNs(iterations, [&] { items += read(user(random), user(random)); });
+    // Giữ kết quả lại để compiler không bỏ qua vòng lặp
+    if (items == static_cast<size_t>(-1)) {
+        printf("%zu\n", items);
+    }
+    return ns / 1000.0;
+}
+
+static void report(const char *name, double sql, double graph)
+{
+    printf("%-16s sql %10.2f us   graph %10.2f us   (%.0fx)\n", name, sql, graph, sql / graph);
+}
+
+static void runFriendGraph()
+{
+    QString path = benchDir() + "/friendgraph.db";
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "BenchFriendGraph");
+        db.setDatabaseName(path);
+        if (!db.open()) {
+            printf("cannot open database: %s\n", qPrintable(db.lastError().text()));
+            return;
+        }
+        int64_t seedStart = benchNowNs();
+        if (!seedFriendships(db)) {
+            return;
+        }
+        printf("seeded %d users, ~%d edges in %.1f s\n",
+               FRIENDGRAPH_USERS,
+               FRIENDGRAPH_USERS * FRIENDGRAPH_EDGES_PER_USER / 2,
+               static_cast<double>(benchNowNs() - seedStart) / 1e9);
+    }
+
+    FriendGraph graph;
+    int64_t loadStart = benchNowNs();
+    if (!graph.load(path.toStdString())) {
+        printf("friend graph load failed\n");
+        return;
+    }
+    printf("graph loaded in %.1f ms\n", static_cast<double>(benchNowNs() - loadStart) / 1e6);
+
+    QSqlDatabase db = QSqlDatabase::database("BenchFriendGraph");
+
+    double sqlStatus = measureSql(db,
+                                  "select Status, UserID1 from Friendships "
+                                  "where (UserID1 = :UserID1 and UserID2 = :UserID2) "
+                                  "or (UserID1 = :UserID2 and UserID2 = :UserID1);",
+                                  FRIENDGRAPH_QUERIES,
+                                  [](QSqlQuery &query, int from, int to) {
+                                      query.bindValue(":UserID1", from);
+                                      query.bindValue(":UserID2", to);
+                                  });
+    double graphStatus = measureGraph(FRIENDGRAPH_QUERIES, [&](int from, int to) {
+        return static_cast<size_t>(graph.status(from, to) == FriendStatus::Friends);
+    });
+    report("friend status", sqlStatus, graphStatus);
+
+    double sqlFriends = measureSql(db,
+                                   "SELECT u.UserID, u.Username "
+                                   "FROM Users u "
+                                   "JOIN Friendships f ON (u.UserID = f.UserID1 OR u.UserID = f.UserID2) "
+                                   "WHERE (f.UserID1 = :UserID OR f.UserID2 = :UserID) AND f.Status = 1 "
+                                   "AND u.UserID != :UserID;",
+                                   FRIENDGRAPH_QUERIES / 10,
+                                   [](QSqlQuery &query, int userID, int) {
+                                       query.bindValue(":UserID", userID);
+                                   });
+    double graphFriends = measureGraph(FRIENDGRAPH_QUERIES, [&](int userID, int) {
+        return graph.friends(userID).size();
+    });
+    report("friends list", sqlFriends, graphFriends);
+
+    double sqlUsers = measureSql(db,
+                                 "select UserID, Username from Users;",
+                                 FRIENDGRAPH_QUERIES / 100,
+                                 [](QSqlQuery &, int, int) {});
+    double graphUsers = measureGraph(FRIENDGRAPH_QUERIES / 100, [&](int, int) {
+        return graph.allUsers().size();
+    });
+    report("all users", sqlUsers, graphUsers);
+}
+
+BENCHMARK(friendgraph)
+{
+    runFriendGraph();
+    QSqlDatabase::removeDatabase("BenchFriendGraph");
+}
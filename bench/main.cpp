@@ -0,0 +1,113 @@
+#include "bench.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct BenchEntry
+{
+    const char *name;
+    BenchFunction function;
+};
+
+std::vector<BenchEntry> &registry()
+{
+    static std::vector<BenchEntry> list;
+    return list;
+}
+
+QString currentDir;
+bool verbose = false;
+
+// Server ghi qDebug cho mỗi request: chỉ in khi --verbose để không đo tốc độ của console
+void benchMessageHandler(QtMsgType type, const QMessageLogContext &, const QString &message)
+{
+    if (type == QtDebugMsg && !verbose) {
+        return;
+    }
+    fprintf(stderr, "%s\n", qPrintable(message));
+}
+
+// Tắt giới hạn tốc độ: benchmark đo đường xử lý request chứ không đo token bucket.
+// Phải ghi trước lần gọi serverConfig() đầu tiên.
+bool writeBenchConfig()
+{
+    QFile file("server.ini");
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        return false;
+    }
+    QByteArray ini = "[rateLimit]\n";
+    for (const char *rateClass : {"auth", "message", "query", "social", "control"}) {
+        ini += QByteArray(rateClass) + "/perSecond=0\n";
+        ini += QByteArray(rateClass) + "/userPerSecond=0\n";
+    }
+    file.write(ini);
+    return true;
+}
+
+} // namespace
+
+BenchRegistrar::BenchRegistrar(const char *name, BenchFunction function)
+{
+    registry().push_back({name, function});
+}
+
+QString benchDir()
+{
+    return currentDir;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    std::vector<std::string> selected;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--verbose") == 0) {
+            verbose = true;
+        } else if (std::strcmp(argv[i], "--list") == 0) {
+            for (const BenchEntry &entry : registry()) {
+                printf("%s\n", entry.name);
+            }
+            return 0;
+        } else {
+            selected.push_back(argv[i]);
+        }
+    }
+    qInstallMessageHandler(benchMessageHandler);
+
+    // Mỗi lần chạy dùng database và server.ini mới trong một thư mục tạm
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        fprintf(stderr, "Cannot create temporary directory\n");
+        return 1;
+    }
+    currentDir = dir.path();
+    QDir::setCurrent(currentDir);
+    if (!writeBenchConfig()) {
+        fprintf(stderr, "Cannot write server.ini\n");
+        return 1;
+    }
+
+    int ran = 0;
+    for (const BenchEntry &entry : registry()) {
+        if (!selected.empty() && std::find(selected.begin(), selected.end(), entry.name) == selected.end()) {
+            continue;
+        }
+        printf("== %s\n", entry.name);
+        fflush(stdout);
+        entry.function();
+        fflush(stdout);
+        ++ran;
+    }
+    if (ran == 0) {
+        fprintf(stderr, "No matching benchmark, use --list\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include "bench.h"
+#include "config.h"
+#include "passwordhash.h"
+#include "workerpool.h"
+#include <atomic>
+#include <mutex>
+
+// Chi phí PBKDF2 với số vòng đang cấu hình, và admission control của auth pool khi
+// một đợt login dồn dập vượt quá authMaxQueued.
+#define PASSWORDHASH_SAMPLES 20
+// Số login trong đợt dồn dập, tính theo bội số của authMaxQueued
+#define PASSWORDHASH_BURST_FACTOR 4
+
+static void runHashLatency(const QString &stored)
+{
+    std::vector<double> hashUs;
+    std::vector<double> verifyUs;
+    bool needsRehash = false;
+    for (int i = 0; i < PASSWORDHASH_SAMPLES; ++i) {
+        int64_t start = benchNowNs();
+        hashPassword("correct horse battery staple");
+        hashUs.push_back(static_cast<double>(benchNowNs() - start) / 1000.0);
+
+        start = benchNowNs();
+        verifyPassword("correct horse battery staple", stored, needsRehash);
+        verifyUs.push_back(static_cast<double>(benchNowNs() - start) / 1000.0);
+    }
+    printf("hashPassword   p50 %10.0f us   p99 %10.0f us\n", percentile(hashUs, 0.5), percentile(hashUs, 0.99));
+    printf("verifyPassword p50 %10.0f us   p99 %10.0f us\n", percentile(verifyUs, 0.5), percentile(verifyUs, 0.99));
+}
+
+// Gửi một đợt verifyPassword vào pool cấu hình giống authPool, đếm số bị từ chối
+// và đo thời gian chờ + chạy của các yêu cầu được nhận
+static void runAdmission(const QString &stored)
+{
+    const ServerConfig &config = serverConfig();
+    int burst = config.authMaxQueued * PASSWORDHASH_BURST_FACTOR;
+    std::mutex mutex;
+    std::vector<double> latencyUs;
+    int accepted = 0;
+    int64_t start = benchNowNs();
+    {
+        WorkerPool pool("benchAuth", config.authThreads, config.authMaxQueued);
+        for (int i = 0; i < burst; ++i) {
+            int64_t submitted = benchNowNs();
+            bool ok = pool.trySubmit([&, submitted] {
+                bool needsRehash = false;
+                verifyPassword("correct horse battery staple", stored, needsRehash);
+                double us = static_cast<double>(benchNowNs() - submitted) / 1000.0;
+                std::lock_guard<std::mutex> lock(mutex);
+                latencyUs.push_back(us);
+            });
+            if (ok) {
+                ++accepted;
+            }
+        }
+        pool.shutdown();
+    }
+    double seconds = static_cast<double>(benchNowNs() - start) / 1e9;
+    printf("burst of %d logins on %d auth threads (maxQueued %d): %d accepted, %d rejected\n",
+           burst,
+           config.authThreads,
+           config.authMaxQueued,
+           accepted,
+           burst - accepted);
+    printf("accepted: %.0f verify/s, latency p50 %.1f ms   p99 %.1f ms\n",
+           accepted / seconds,
+           percentile(latencyUs, 0.5) / 1000.0,
+           percentile(latencyUs, 0.99) / 1000.0);
+}
+
+BENCHMARK(passwordhash)
+{
+    printf("pbkdf2Iterations = %d\n", serverConfig().pbkdf2Iterations);
+    QString stored = hashPassword("correct horse battery staple");
+    runHashLatency(stored);
+    runAdmission(stored);
+}
@@ -0,0 +1,285 @@
+#include "codec.h"
+#include <QCborStreamReader>
+#include <QCborStreamWriter>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QLatin1String>
+
+RequestValue::RequestValue(const QJsonValue &value)
+    : m_isCbor(false)
+    , m_json(value)
+{}
+
+RequestValue::RequestValue(const QCborValue &value)
+    : m_isCbor(true)
+    , m_cbor(value)
+{}
+
+bool RequestValue::isUndefined() const
+{
+    return m_isCbor ? m_cbor.isUndefined() : m_json.isUndefined();
+}
+
+bool RequestValue::isString() const
+{
+    return m_isCbor ? m_cbor.isString() : m_json.isString();
+}
+
+int RequestValue::toInt(int defaultValue) const
+{
+    return static_cast<int>(toLongLong(defaultValue));
+}
+
+qint64 RequestValue::toLongLong(qint64 defaultValue) const
+{
+    if (m_isCbor) {
+        return m_cbor.isDouble() ? static_cast<qint64>(m_cbor.toDouble()) : m_cbor.toInteger(defaultValue);
+    }
+    return m_json.toInteger(defaultValue);
+}
+
+bool RequestValue::toBool(bool defaultValue) const
+{
+    return m_isCbor ? m_cbor.toBool(defaultValue) : m_json.toBool(defaultValue);
+}
+
+QString RequestValue::toString() const
+{
+    return m_isCbor ? m_cbor.toString() : m_json.toString();
+}
+
+QJsonValue RequestValue::toJsonValue() const
+{
+    return m_isCbor ? m_cbor.toJsonValue() : m_json;
+}
+
+Request::Request(const QJsonObject &object)
+    : m_isCbor(false)
+    , m_json(object)
+{}
+
+Request::Request(const QCborMap &map)
+    : m_isCbor(true)
+    , m_cbor(map)
+{}
+
+RequestValue Request::operator[](const char *key) const
+{
+    if (m_isCbor) {
+        return RequestValue(m_cbor.value(QLatin1String(key)));
+    }
+    return RequestValue(m_json.value(QLatin1String(key)));
+}
+
+bool Request::contains(const char *key) const
+{
+    return m_isCbor ? m_cbor.contains(QLatin1String(key)) : m_json.contains(QLatin1String(key));
+}
+
+QString Request::action() const
+{
+    return (*this)["action"].toString();
+}
+
+QJsonObject Request::toJsonObject() const
+{
+    return m_isCbor ? m_cbor.toJsonObject() : m_json;
+}
+
+bool decodeRequest(const QByteArray &payload, Request &request)
+{
+    if (payload.isEmpty()) {
+        return false;
+    }
+    unsigned char first = static_cast<unsigned char>(payload[0]);
+    if (first == '{') {
+        QJsonDocument document = QJsonDocument::fromJson(payload);
+        if (!document.isObject()) {
+            return false;
+        }
+        request = Request(document.object());
+    } else if ((first >> 5) == 5) {
+        QCborValue value = QCborValue::fromCbor(payload);
+        if (!value.isMap()) {
+            return false;
+        }
+        request = Request(value.toMap());
+    } else {
+        return false;
+    }
+    request.m_opcode = opcodeForAction(request.action());
+    return true;
+}
+
+// Tìm khóa "action" theo sau là ':' (một chuỗi "action" là giá trị thì theo sau là ',' hoặc '}').
+// Tên action không có ký tự escape, gặp '\' thì coi như không tìm được.
+static Opcode peekJsonOpcode(const QByteArray &payload)
+{
+    const char *data = payload.constData();
+    const qsizetype size = payload.size();
+    for (qsizetype key = payload.indexOf("\"action\""); key >= 0; key = payload.indexOf("\"action\"", key + 1)) {
+        qsizetype i = key + 8;
+        while (i < size && (data[i] == ' ' || data[i] == '\t' || data[i] == '\r' || data[i] == '\n')) {
+            ++i;
+        }
+        if (i >= size || data[i] != ':') {
+            continue;
+        }
+        ++i;
+        while (i < size && (data[i] == ' ' || data[i] == '\t' || data[i] == '\r' || data[i] == '\n')) {
+            ++i;
+        }
+        if (i >= size || data[i] != '"') {
+            return Opcode::Unknown;
+        }
+        const qsizetype start = ++i;
+        while (i < size && data[i] != '"' && data[i] != '\\') {
+            ++i;
+        }
+        if (i >= size || data[i] != '"') {
+            return Opcode::Unknown;
+        }
+        return opcodeForAction(data + start, static_cast<size_t>(i - start));
+    }
+    return Opcode::Unknown;
+}
+
+// Đọc hết một text string (có thể chia nhiều đoạn), false nếu payload hỏng
+static bool readCborString(QCborStreamReader &reader, QString &text)
+{
+    QCborStreamReader::StringResult<QString> chunk = reader.readString();
+    while (chunk.status == QCborStreamReader::Ok) {
+        text += chunk.data;
+        chunk = reader.readString();
+    }
+    return chunk.status == QCborStreamReader::EndOfString;
+}
+
+// Duyệt các cặp khóa/giá trị của map ngoài cùng, bỏ qua giá trị không cần mà không giải mã
+static Opcode peekCborOpcode(const QByteArray &payload)
+{
+    QCborStreamReader reader(payload);
+    if (!reader.isMap() || !reader.enterContainer()) {
+        return Opcode::Unknown;
+    }
+    while (reader.lastError() == QCborError::NoError && reader.hasNext()) {
+        if (!reader.isString()) {
+            if (!reader.next() || !reader.next()) {
+                return Opcode::Unknown;
+            }
+            continue;
+        }
+        QString key;
+        if (!readCborString(reader, key)) {
+            return Opcode::Unknown;
+        }
+        if (key == QLatin1String("action")) {
+            QString action;
+            if (!reader.isString() || !readCborString(reader, action)) {
+                return Opcode::Unknown;
+            }
+            return opcodeForAction(action);
+        }
+        if (!reader.next()) {
+            return Opcode::Unknown;
+        }
+    }
+    return Opcode::Unknown;
+}
+
+Opcode peekOpcode(const QByteArray &payload)
+{
+    if (payload.isEmpty()) {
+        return Opcode::Unknown;
+    }
+    unsigned char first = static_cast<unsigned char>(payload[0]);
+    if (first == '{') {
+        return peekJsonOpcode(payload);
+    }
+    if ((first >> 5) == 5) {
+        return peekCborOpcode(payload);
+    }
+    return Opcode::Unknown;
+}
+
+static void writeCbor(QCborStreamWriter &writer, const QJsonObject &object);
+
+static void writeCbor(QCborStreamWriter &writer, const QJsonValue &value)
+{
+    switch (value.type()) {
+    case QJsonValue::Bool:
+        writer.append(value.toBool());
+        break;
+    case QJsonValue::Double: {
+        // QJsonValue giữ nguyên số nguyên 64 bit (ID, timestamp): ghi thành CBOR integer,
+        // chỉ số thực thật sự mới ghi thành double
+        qint64 integer = value.toInteger();
+        double real = value.toDouble();
+        if (integer != 0 || real == 0) {
+            writer.append(integer);
+        } else {
+            writer.append(real);
+        }
+        break;
+    }
+    case QJsonValue::String: {
+        QString text = value.toString();
+        writer.append(QStringView(text));
+        break;
+    }
+    case QJsonValue::Array: {
+        QJsonArray array = value.toArray();
+        writer.startArray(static_cast<quint64>(array.size()));
+        for (qsizetype i = 0; i < array.size(); ++i) {
+            writeCbor(writer, array.at(i));
+        }
+        writer.endArray();
+        break;
+    }
+    case QJsonValue::Object:
+        writeCbor(writer, value.toObject());
+        break;
+    case QJsonValue::Undefined:
+        writer.appendUndefined();
+        break;
+    default:
+        writer.appendNull();
+        break;
+    }
+}
+
+static void writeCbor(QCborStreamWriter &writer, const QJsonObject &object)
+{
+    writer.startMap(static_cast<quint64>(object.size()));
+    for (auto it = object.constBegin(); it != object.constEnd(); ++it) {
+        QString key = it.key();
+        writer.append(QStringView(key));
+        writeCbor(writer, it.value());
+    }
+    writer.endMap();
+}
+
+QByteArray encodeMessage(const QJsonObject &message, WireEncoding encoding)
+{
+    if (encoding == WireEncoding::Cbor) {
+        // Ghi thẳng vào buffer đầu ra, không dựng QCborMap trung gian
+        QByteArray payload;
+        QCborStreamWriter writer(&payload);
+        writeCbor(writer, message);
+        return payload;
+    }
+    return QJsonDocument(message).toJson(QJsonDocument::Compact);
+}
+
+EncodedMessage::EncodedMessage(const QJsonObject &message)
+    : m_message(message)
+{}
+
+const QByteArray &EncodedMessage::payload(WireEncoding encoding)
+{
+    QByteArray &cached = encoding == WireEncoding::Cbor ? m_cbor : m_json;
+    if (cached.isEmpty()) {
+        cached = encodeMessage(m_message, encoding);
+    }
+    return cached;
+}
@@ -0,0 +1,99 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <QByteArray>
+#include <QCborMap>
+#include <QCborValue>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QString>
+#include <cstdint>
+#include "opcode.h"
+
+// Kiểu mã hóa payload của một kết nối. Mặc định là JSON; client gửi
+// {"action":"hello","encoding":"cbor"} để chuyển sang CBOR cho cả hai chiều.
+enum class WireEncoding : uint8_t {
+    Json,
+    Cbor,
+};
+
+// Một trường của request, không phụ thuộc request đến từ JSON hay CBOR
+class RequestValue
+{
+public:
+    explicit RequestValue(const QJsonValue &value);
+    explicit RequestValue(const QCborValue &value);
+
+    bool isUndefined() const;
+    bool isString() const;
+    int toInt(int defaultValue = 0) const;
+    qint64 toLongLong(qint64 defaultValue = 0) const;
+    bool toBool(bool defaultValue = false) const;
+    QString toString() const;
+    // Dùng khi cần chép nguyên giá trị sang phản hồi (ví dụ clientMessageId)
+    QJsonValue toJsonValue() const;
+
+private:
+    bool m_isCbor;
+    QJsonValue m_json;
+    QCborValue m_cbor;
+};
+
+// Request đã giải mã. Handler đọc các trường qua request["key"] như với QJsonObject,
+// dữ liệu CBOR được đọc thẳng từ QCborMap mà không chuyển qua JSON.
+class Request
+{
+public:
+    Request() = default;
+    explicit Request(const QJsonObject &object);
+    explicit Request(const QCborMap &map);
+
+    RequestValue operator[](const char *key) const;
+    bool contains(const char *key) const;
+    QString action() const;
+    // Opcode của action, tra một lần khi giải mã
+    Opcode opcode() const { return m_opcode; }
+    WireEncoding encoding() const { return m_isCbor ? WireEncoding::Cbor : WireEncoding::Json; }
+    // Bản sao dạng JSON của toàn bộ request (tốn chi phí chuyển đổi với CBOR)
+    QJsonObject toJsonObject() const;
+
+private:
+    bool m_isCbor = false;
+    Opcode m_opcode = Opcode::Unknown;
+    QJsonObject m_json;
+    QCborMap m_cbor;
+
+    friend bool decodeRequest(const QByteArray &payload, Request &request);
+
+// Đọc riêng trường "action" ở mức trên cùng mà không dựng cả request, để kiểm tra
+// giới hạn tốc độ trước khi giải mã. Opcode::Unknown nếu không tìm được.
+Opcode peekOpcode(const QByteArray &payload);
+};
+
+// Giải mã payload của một frame. Payload JSON luôn bắt đầu bằng '{',
+// còn CBOR map bắt đầu bằng byte có major type 5 (0xA0-0xBF).
+bool decodeRequest(const QByteArray &payload, Request &request);
+
+// Đọc riêng trường "action" ở mức trên cùng mà không dựng cả request, để kiểm tra
+// giới hạn tốc độ trước khi giải mã. Opcode::Unknown nếu không tìm được.
+Opcode peekOpcode(const QByteArray &payload);
+
+QByteArray encodeMessage(const QJsonObject &message, WireEncoding encoding);
+
+// Một message gửi tới nhiều kết nối: mỗi kiểu mã hóa chỉ serialize một lần và
+// mọi kết nối cùng kiểu dùng chung một QByteArray.
+// Không thread-safe: chỉ dùng trên luồng đang fan-out.
+class EncodedMessage
+{
+public:
+    explicit EncodedMessage(const QJsonObject &message);
+
+    const QByteArray &payload(WireEncoding encoding);
+
+private:
+    QJsonObject m_message;
+    QByteArray m_json;
+    QByteArray m_cbor;
+};
+
+#endif // CODEC_H
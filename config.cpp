@@ -0,0 +1,92 @@
+#include "config.h"
+#include <QDebug>
+#include <QSettings>
+#include <algorithm>
+#include <thread>
+
+static ServerConfig loadConfig()
+{
+    ServerConfig config;
+    QSettings settings(QString::fromLatin1(CONFIG_FILE), QSettings::IniFormat);
+
+    settings.beginGroup("network");
+    config.reactorThreads = std::max(1, settings.value("reactorThreads", config.reactorThreads).toInt());
+    config.workerThreads = settings.value("workerThreads", config.workerThreads).toInt();
+    config.maxConnections = std::max(1, settings.value("maxConnections", config.maxConnections).toInt());
+    config.maxFrameSize = std::max(1024, settings.value("maxFrameSize", config.maxFrameSize).toInt());
+    config.writeHighWaterMark
+        = std::max(4096, settings.value("writeHighWaterMark", config.writeHighWaterMark).toInt());
+    config.maxOutboundBytes = std::max(config.writeHighWaterMark * 2,
+                                       settings.value("maxOutboundBytes", config.maxOutboundBytes).toInt());
+    settings.endGroup();
+
+    settings.beginGroup("log");
+    config.logQueueCapacity = std::max(1024, settings.value("queueCapacity", config.logQueueCapacity).toInt());
+    config.logFlushIntervalMs = std::max(1, settings.value("flushIntervalMs", config.logFlushIntervalMs).toInt());
+    config.logMaxFileSize = std::max(4096, settings.value("maxFileSize", config.logMaxFileSize).toInt());
+    config.logRotateMinutes = std::max(0, settings.value("rotateMinutes", config.logRotateMinutes).toInt());
+    settings.endGroup();
+
+    settings.beginGroup("messages");
+    config.messageBatchSize = std::max(1, settings.value("batchSize", config.messageBatchSize).toInt());
+    config.messageBatchDelayMs = std::max(0, settings.value("batchDelayMs", config.messageBatchDelayMs).toInt());
+    config.ackAfterCommit = settings.value("ackMode", "commit").toString() != "enqueue";
+    settings.endGroup();
+
+    settings.beginGroup("presence");
+    config.presenceCoalesceMs = std::max(0, settings.value("coalesceMs", config.presenceCoalesceMs).toInt());
+    settings.endGroup();
+
+    settings.beginGroup("auth");
+    config.authThreads = settings.value("threads", config.authThreads).toInt();
+    config.authMaxQueued = std::max(1, settings.value("maxQueued", config.authMaxQueued).toInt());
+    config.pbkdf2Iterations = std::max(1000, settings.value("pbkdf2Iterations", config.pbkdf2Iterations).toInt());
+    config.sessionTokenTtlMinutes
+        = std::max(1, settings.value("sessionTokenTtlMinutes", config.sessionTokenTtlMinutes).toInt());
+    settings.endGroup();
+
+    settings.beginGroup("heartbeat");
+    config.heartbeatTickMs = std::max(10, settings.value("tickMs", config.heartbeatTickMs).toInt());
+    config.pingIntervalMs
+        = std::max(config.heartbeatTickMs, settings.value("pingIntervalMs", config.pingIntervalMs).toInt());
+    config.idleTimeoutMs = std::max(config.pingIntervalMs + config.heartbeatTickMs,
+                                    settings.value("idleTimeoutMs", config.idleTimeoutMs).toInt());
+    settings.endGroup();
+
+    settings.beginGroup("rateLimit");
+    for (size_t i = 0; i < static_cast<size_t>(RateClass::Count); ++i) {
+        RateLimitConfig &limit = config.rateLimits[i];
+        QString prefix = QString::fromLatin1(rateClassName(static_cast<RateClass>(i))) + "/";
+        limit.perSecond = std::max(0.0, settings.value(prefix + "perSecond", limit.perSecond).toDouble());
+        limit.burst = std::max(1, settings.value(prefix + "burst", limit.burst).toInt());
+        limit.userPerSecond = std::max(0.0, settings.value(prefix + "userPerSecond", limit.userPerSecond).toDouble());
+        limit.userBurst = std::max(1, settings.value(prefix + "userBurst", limit.userBurst).toInt());
+    }
+    config.rateLimitUserSlots = std::max(1, settings.value("userSlots", config.rateLimitUserSlots).toInt());
+    settings.endGroup();
+
+    settings.beginGroup("database");
+    config.dbBusyTimeoutMs = std::max(0, settings.value("busyTimeoutMs", config.dbBusyTimeoutMs).toInt());
+    config.dbCacheSizeKb = std::max(0, settings.value("cacheSizeKb", config.dbCacheSizeKb).toInt());
+    config.dbMmapSize = std::max<qint64>(0, settings.value("mmapSize", config.dbMmapSize).toLongLong());
+    settings.endGroup();
+
+    if (config.workerThreads <= 0) {
+        config.workerThreads = std::max(2, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+    if (config.authThreads <= 0) {
+        config.authThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) / 4);
+    }
+
+    qDebug() << "Config: reactorThreads =" << config.reactorThreads
+             << "workerThreads =" << config.workerThreads
+             << "authThreads =" << config.authThreads
+             << "ackMode =" << (config.ackAfterCommit ? "commit" : "enqueue");
+    return config;
+}
+
+const ServerConfig &serverConfig()
+{
+    static const ServerConfig config = loadConfig();
+    return config;
+}
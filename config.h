@@ -0,0 +1,91 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include "opcode.h"
+#include <QtGlobal>
+
+#define CONFIG_FILE "server.ini"
+
+// Giới hạn tốc độ của một nhóm action: trung bình perSecond request/giây, cho phép
+// dồn tối đa burst request liền nhau. perSecond = 0 thì không giới hạn.
+struct RateLimitConfig
+{
+    double perSecond;
+    int burst;
+    // Giới hạn chung cho mọi kết nối của cùng một người dùng đã đăng nhập
+    double userPerSecond;
+    int userBurst;
+};
+
+// Cấu hình server, đọc một lần từ server.ini (nếu có) cạnh ChatApp.db
+struct ServerConfig
+{
+    // Số luồng reactor (epoll) giữ các socket; chỉ dùng trên Linux
+    int reactorThreads = 1;
+    // Số luồng xử lý request; 0 = số lõi CPU
+    int workerThreads = 0;
+    // Số kết nối mở đồng thời tối đa; kết nối mới khi đã đầy bị đóng ngay
+    int maxConnections = 10000;
+    // Kích thước tối đa của một request (byte)
+    int maxFrameSize = 1024 * 1024;
+    // Khi dữ liệu chờ gửi của một kết nối vượt ngưỡng này, server ngừng đọc request
+    // mới từ kết nối đó cho đến khi hàng đợi giảm còn một nửa
+    int writeHighWaterMark = 1024 * 1024;
+    // Quá giới hạn này thì client được coi là không đọc nữa và bị ngắt kết nối
+    int maxOutboundBytes = 16 * 1024 * 1024;
+
+    // Số dòng log tối đa chờ ghi; đầy thì dòng mới bị bỏ
+    int logQueueCapacity = 65536;
+    // Chu kỳ luồng nền ghi một lô log xuống file (ms)
+    int logFlushIntervalMs = 100;
+    // Sang file log mới khi file hiện tại vượt kích thước (byte) hoặc thời gian (phút, 0 = tắt)
+    int logMaxFileSize = 64 * 1024 * 1024;
+    int logRotateMinutes = 24 * 60;
+
+    // Gom tin nhắn thành một transaction khi đủ batchSize tin hoặc sau batchDelayMs
+    int messageBatchSize = 256;
+    int messageBatchDelayMs = 10;
+    // true: chỉ báo gửi thành công cho người gửi sau khi lô đã commit (ackMode=commit)
+    // false: báo ngay khi tin vào hàng đợi, nhanh hơn nhưng có thể mất tin khi sập (ackMode=enqueue)
+    bool ackAfterCommit = true;
+
+    // Thay đổi online/offline được báo cho bạn bè sau cửa sổ này (ms); kết nối rồi
+    // ngắt trong cửa sổ chỉ sinh nhiều nhất một sự kiện
+    int presenceCoalesceMs = 2000;
+
+    // Luồng riêng cho băm/kiểm tra mật khẩu (0 = 1/4 số lõi CPU, tối thiểu 1) để
+    // login dồn dập không chiếm worker xử lý tin nhắn. Quá authMaxQueued yêu cầu
+    // đang chờ thì login/register mới bị từ chối ngay với "server busy".
+    int authThreads = 0;
+    int authMaxQueued = 256;
+    int pbkdf2Iterations = 100000;
+    // Thời hạn token phiên (phút), được gia hạn mỗi lần resumeSession
+    int sessionTokenTtlMinutes = 7 * 24 * 60;
+
+    // Token bucket theo kết nối và theo người dùng cho từng RateClass (cùng thứ tự với enum).
+    // Trong server.ini: nhóm [rateLimit], khóa <tên nhóm>/perSecond, /burst, /userPerSecond, /userBurst
+    RateLimitConfig rateLimits[static_cast<size_t>(RateClass::Count)] = {
+        {1, 5, 2, 10},       // auth
+        {20, 50, 30, 100},   // message
+        {10, 30, 20, 60},    // query
+        {2, 10, 4, 20},      // social
+        {50, 100, 100, 200}, // control
+    };
+    // Số ô của bảng bucket theo người dùng, làm tròn lên lũy thừa của 2
+    int rateLimitUserSlots = 16384;
+
+    // Kết nối im lặng quá pingIntervalMs được gửi "ping"; không nhận được gì trong
+    // idleTimeoutMs thì bị đóng. heartbeatTickMs là độ phân giải của timer wheel.
+    int pingIntervalMs = 30000;
+    int idleTimeoutMs = 90000;
+    int heartbeatTickMs = 250;
+
+    // PRAGMA cho mọi kết nối SQLite
+    int dbBusyTimeoutMs = 5000;
+    int dbCacheSizeKb = 16 * 1024;
+    qint64 dbMmapSize = 256LL * 1024 * 1024;
+};
+
+const ServerConfig &serverConfig();
+
+#endif // CONFIG_H
@@ -0,0 +1,217 @@
+#include "connection.h"
+#include "config.h"
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+#ifndef _WIN32
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#endif
+
+// Số frame tối đa gom vào một lần writev/WSASend (mỗi frame tối đa 2 đoạn)
+#define MAX_FRAMES_PER_WRITE 32
+
+Connection::Connection(SOCKET sock, const std::string &ip)
+    : socket(sock)
+    , peerIp(ip)
+    , decoder(serverConfig().maxFrameSize)
+{
+#ifndef _WIN32
+    interestMask = EPOLLIN | EPOLLRDHUP | EPOLLET;
+#endif
+}
+
+Connection::~Connection()
+{
+    if (socket != INVALID_SOCKET) {
+        closesocket(socket);
+    }
+}
+
+bool Connection::sendFrame(const QByteArray &payload)
+{
+    std::lock_guard<std::mutex> lock(writeMutex);
+    return queueFrameLocked(payload);
+}
+
+bool Connection::sendMessage(EncodedMessage &message, size_t *bytes)
+{
+    std::lock_guard<std::mutex> lock(writeMutex);
+    const QByteArray &payload = message.payload(encoding.load(std::memory_order_relaxed));
+    if (bytes) {
+        *bytes = static_cast<size_t>(payload.size());
+    }
+    return queueFrameLocked(payload);
+}
+
+bool Connection::sendFrame(const QByteArray &jsonPayload, const QByteArray &cborPayload)
+{
+    std::lock_guard<std::mutex> lock(writeMutex);
+    bool cbor = encoding.load(std::memory_order_relaxed) == WireEncoding::Cbor;
+    return queueFrameLocked(cbor ? cborPayload : jsonPayload);
+}
+
+bool Connection::sendFrameAndSwitchEncoding(const QByteArray &payload, WireEncoding next)
+{
+    std::lock_guard<std::mutex> lock(writeMutex);
+    bool queued = queueFrameLocked(payload);
+    encoding.store(next, std::memory_order_relaxed);
+    return queued;
+}
+
+bool Connection::queueFrameLocked(const QByteArray &payload)
+{
+    if (closing) {
+        return false;
+    }
+
+    OutboundFrame frame;
+    frame.headerLen = 0;
+    if (decoder.mode() == FrameMode::LengthPrefixed) {
+        writeFrameHeader(frame.header, static_cast<size_t>(payload.size()));
+        frame.headerLen = FRAME_HEADER_SIZE;
+    }
+    frame.payload = payload;
+
+    if (outboundBytes + frame.size() > static_cast<size_t>(serverConfig().maxOutboundBytes)) {
+        qDebug() << "Client" << QString::fromStdString(peerIp)
+                 << "is not reading its responses, closing connection.";
+        close();
+        return false;
+    }
+
+    bool wasIdle = outbound.empty();
+    outboundBytes += frame.size();
+    outbound.push_back(std::move(frame));
+
+    // Đang có dữ liệu chờ EPOLLOUT thì chỉ xếp hàng, reactor sẽ gửi tiếp
+    if (wasIdle && !flushLocked()) {
+        close();
+        return false;
+    }
+    updateInterestLocked();
+    return true;
+}
+
+void Connection::onWritable()
+{
+    std::lock_guard<std::mutex> lock(writeMutex);
+    if (closing) {
+        return;
+    }
+    if (!flushLocked()) {
+        close();
+        return;
+    }
+    updateInterestLocked();
+}
+
+void Connection::close()
+{
+    if (!closing.exchange(true)) {
+        shutdown(socket, SD_BOTH);
+    }
+}
+
+bool Connection::flushLocked()
+{
+    while (!outbound.empty()) {
+        // Gom nhiều frame trong hàng đợi vào một lần gọi hệ thống
+#ifdef _WIN32
+        WSABUF buffers[MAX_FRAMES_PER_WRITE * 2];
+#else
+        struct iovec buffers[MAX_FRAMES_PER_WRITE * 2];
+#endif
+        int count = 0;
+        size_t skip = outboundOffset;
+        size_t frames = std::min<size_t>(outbound.size(), MAX_FRAMES_PER_WRITE);
+        for (size_t i = 0; i < frames; ++i) {
+            const OutboundFrame &frame = outbound[i];
+            const char *parts[2] = {frame.header, frame.payload.constData()};
+            size_t lengths[2] = {frame.headerLen, static_cast<size_t>(frame.payload.size())};
+            for (int p = 0; p < 2; ++p) {
+                if (skip >= lengths[p]) {
+                    skip -= lengths[p];
+                    continue;
+                }
+#ifdef _WIN32
+                buffers[count].buf = const_cast<char *>(parts[p] + skip);
+                buffers[count].len = static_cast<ULONG>(lengths[p] - skip);
+#else
+                buffers[count].iov_base = const_cast<char *>(parts[p] + skip);
+                buffers[count].iov_len = lengths[p] - skip;
+#endif
+                skip = 0;
+                ++count;
+            }
+        }
+
+        size_t sent = 0;
+#ifdef _WIN32
+        DWORD bytesSent = 0;
+        if (WSASend(socket, buffers, count, &bytesSent, 0, NULL, NULL) == SOCKET_ERROR) {
+            qDebug() << "send failed with error: " << lastSocketError();
+            return false;
+        }
+        sent = bytesSent;
+#else
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = buffers;
+        msg.msg_iovlen = count;
+        ssize_t result = sendmsg(socket, &msg, SOCKET_SEND_FLAGS);
+        if (result < 0) {
+            int error = lastSocketError();
+            if (socketWouldBlock(error)) {
+                return true; // chờ EPOLLOUT
+            }
+            if (error == EINTR) {
+                continue;
+            }
+            qDebug() << "send failed with error: " << error;
+            return false;
+        }
+        sent = static_cast<size_t>(result);
+#endif
+
+        // Bỏ các frame đã gửi hết, ghi nhớ vị trí trong frame gửi dở
+        outboundBytes -= sent;
+        sent += outboundOffset;
+        while (!outbound.empty() && sent >= outbound.front().size()) {
+            sent -= outbound.front().size();
+            outbound.pop_front();
+        }
+        outboundOffset = sent;
+    }
+    return true;
+}
+
+void Connection::updateInterestLocked()
+{
+    size_t highWaterMark = static_cast<size_t>(serverConfig().writeHighWaterMark);
+    if (!paused && outboundBytes > highWaterMark) {
+        paused = true;
+    } else if (paused && outboundBytes <= highWaterMark / 2) {
+        paused = false;
+    }
+
+#ifndef _WIN32
+    // Tạm ngừng đọc khi client không nhận kịp để áp lực dồn ngược về phía client
+    uint32_t mask = EPOLLRDHUP | EPOLLET;
+    if (!paused) {
+        mask |= EPOLLIN;
+    }
+    if (!outbound.empty()) {
+        mask |= EPOLLOUT;
+    }
+    if (mask != interestMask && epollFd != -1) {
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = mask;
+        ev.data.ptr = this;
+        if (epoll_ctl(epollFd, EPOLL_CTL_MOD, socket, &ev) == 0) {
+            interestMask = mask;
+        }
+    }
+#endif
+}
@@ -0,0 +1,116 @@
+#ifndef CONNECTION_H
+#define CONNECTION_H
+
+#include "codec.h"
+#include "platform.h"
+#include "protocol.h"
+#include "ratelimit.h"
+#include <QByteArray>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Một frame chờ gửi: header độ dài nằm ngay trong struct, payload dùng chung
+// (implicit sharing) với QByteArray của người gọi nên không bị sao chép.
+struct OutboundFrame
+{
+    char header[FRAME_HEADER_SIZE];
+    size_t headerLen;
+    QByteArray payload;
+
+    size_t size() const { return headerLen + static_cast<size_t>(payload.size()); }
+};
+
+// (thế hệ << 32) | ô trong ConnectionTable; 0 = chưa có trong bảng
+typedef uint64_t ConnectionId;
+
+// Trạng thái của một kết nối client.
+// Socket chỉ được đóng khi đối tượng bị hủy, nên khi còn một tham chiếu
+// (ví dụ một worker đang xử lý request) thì số hiệu socket không bị tái sử dụng.
+struct Connection : public std::enable_shared_from_this<Connection>
+{
+    Connection(SOCKET sock, const std::string &ip);
+    ~Connection();
+
+    Connection(const Connection &) = delete;
+    Connection &operator=(const Connection &) = delete;
+
+    // Đưa một payload vào hàng đợi gửi và ghi ngay nếu socket đang rảnh.
+    // Trả về false nếu kết nối đã đóng hoặc bị đóng vì client không đọc kịp.
+    bool sendFrame(const QByteArray &payload);
+    // Như sendFrame nhưng kiểu mã hóa được đọc dưới writeMutex, nên frame không bao giờ
+    // mang kiểu cũ khi nằm sau phản hồi "hello" trong hàng đợi. bytes nhận kích thước payload đã gửi.
+    bool sendMessage(EncodedMessage &message, size_t *bytes = nullptr);
+    bool sendFrame(const QByteArray &jsonPayload, const QByteArray &cborPayload);
+    // Xếp payload vào hàng đợi rồi đổi kiểu mã hóa trong cùng một lần giữ writeMutex:
+    // mọi frame xếp sau payload này đều dùng kiểu mới
+    bool sendFrameAndSwitchEncoding(const QByteArray &payload, WireEncoding next);
+    // Reactor gọi khi socket ghi được trở lại (EPOLLOUT)
+    void onWritable();
+    // Yêu cầu đóng kết nối; reactor sẽ dọn dẹp khi nhận sự kiện hangup
+    void close();
+
+    const SOCKET socket;
+    const std::string peerIp;
+    // Gán một lần bởi ConnectionTable::insert trước khi kết nối được đưa vào reactor
+    ConnectionId id = 0;
+    std::atomic<bool> closing{false};
+    // Kiểu mã hóa của các frame gửi đi, đổi bằng action "hello" (chỉ ghi dưới writeMutex)
+    std::atomic<WireEncoding> encoding{WireEncoding::Json};
+    // Client gửi "deliveryAcks": true trong "hello" sẽ tự gửi ackDelivered; client cũ thì
+    // mốc đã nhận được nâng ngay khi gửi backlog để không nhận lại backlog ở mỗi lần đăng nhập
+    std::atomic<bool> deliveryAcks{false};
+#ifndef _WIN32
+    // epoll của reactor sở hữu socket
+    int epollFd = -1;
+#endif
+
+    // Ghép frame từ dữ liệu nhận được; chỉ luồng đọc socket được dùng
+    FrameDecoder decoder;
+
+    // Các request đã nhận nhưng chưa xử lý. Mỗi kết nối chỉ được lên lịch
+    // trên worker pool một lần tại một thời điểm để giữ thứ tự request.
+    std::mutex requestMutex;
+    std::deque<QByteArray> pendingRequests;
+    bool scheduled = false;
+    // Request hiện tại giao việc cho luồng khác (login/register trên auth pool): các request
+    // sau phải chờ việc đó xong. parkedIdle = lượt xử lý đã dừng lại và chờ resumeRequests.
+    bool parked = false;
+    bool parkedIdle = false;
+    // Client đã đóng chiều gửi; đóng kết nối sau khi xử lý hết pendingRequests
+    bool closeWhenDrained = false;
+
+    // Người dùng đã đăng nhập trên kết nối này (-1 nếu chưa). Gán/gỡ dưới sessionMutex,
+    // sau khi closing đã bật thì không được gán nữa nên phiên không bị bỏ sót khi ngắt kết nối.
+    // Đọc không cần khóa (ví dụ khi kiểm tra giới hạn tốc độ theo người dùng).
+    std::mutex sessionMutex;
+    std::atomic<int> userId{-1};
+
+    // Thời điểm (monotonicMs) nhận dữ liệu cuối cùng, luồng đọc ghi, HeartbeatMonitor đọc
+    std::atomic<int64_t> lastActivityMs{0};
+
+    // Token bucket theo kết nối cho từng nhóm action
+    RateBuckets rateBuckets;
+
+private:
+    bool queueFrameLocked(const QByteArray &payload);
+    bool flushLocked();
+    void updateInterestLocked();
+
+    // Hàng đợi gửi, bảo vệ bởi writeMutex
+    std::mutex writeMutex;
+    std::deque<OutboundFrame> outbound;
+    size_t outboundBytes = 0;
+    // Số byte của outbound.front() đã gửi được
+    size_t outboundOffset = 0;
+    // true khi hàng đợi gửi vượt ngưỡng và reactor tạm ngừng đọc kết nối này
+    bool paused = false;
+    uint32_t interestMask = 0;
+};
+
+typedef std::shared_ptr<Connection> ConnectionPtr;
+
+#endif // CONNECTION_H
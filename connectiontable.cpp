@@ -0,0 +1,76 @@
+#include "connectiontable.h"
+
+static ConnectionId makeConnectionId(uint32_t slot, uint32_t generation)
+{
+    return (static_cast<ConnectionId>(generation) << 32) | slot;
+}
+
+ConnectionTable::ConnectionTable(size_t capacity)
+    : m_capacity(capacity)
+{
+}
+
+bool ConnectionTable::insert(const ConnectionPtr &conn)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint32_t slot;
+    if (!m_freeSlots.empty()) {
+        slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    } else if (m_slots.size() < m_capacity) {
+        slot = static_cast<uint32_t>(m_slots.size());
+        m_slots.emplace_back();
+    } else {
+        m_rejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    m_slots[slot].conn = conn;
+    conn->id = makeConnectionId(slot, m_slots[slot].generation);
+    m_slotBySocket[conn->socket] = slot;
+    m_active.fetch_add(1, std::memory_order_relaxed);
+    m_accepted.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool ConnectionTable::remove(const Connection &conn)
+{
+    uint32_t slot = static_cast<uint32_t>(conn.id);
+    uint32_t generation = static_cast<uint32_t>(conn.id >> 32);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (conn.id == 0 || slot >= m_slots.size() || m_slots[slot].generation != generation) {
+        return false;
+    }
+    m_slots[slot].conn.reset();
+    // Thế hệ 0 dành cho "không hợp lệ"
+    if (++m_slots[slot].generation == 0) {
+        m_slots[slot].generation = 1;
+    }
+    m_freeSlots.push_back(slot);
+    m_slotBySocket.erase(conn.socket);
+    m_active.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+ConnectionPtr ConnectionTable::find(SOCKET socket) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_slotBySocket.find(socket);
+    if (it == m_slotBySocket.end()) {
+        return nullptr;
+    }
+    return m_slots[it->second].conn;
+}
+
+ConnectionPtr ConnectionTable::find(ConnectionId id) const
+{
+    uint32_t slot = static_cast<uint32_t>(id);
+    uint32_t generation = static_cast<uint32_t>(id >> 32);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (id == 0 || slot >= m_slots.size() || m_slots[slot].generation != generation) {
+        return nullptr;
+    }
+    return m_slots[slot].conn;
+}
@@ -0,0 +1,59 @@
+#ifndef CONNECTIONTABLE_H
+#define CONNECTIONTABLE_H
+
+#include "connection.h"
+#include "platform.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Bảng các kết nối đang mở, giới hạn capacity phần tử. Mỗi kết nối chiếm một ô;
+// ô được tái sử dụng sau khi kết nối đóng và mang số thế hệ tăng dần, nên một
+// ConnectionId cũ không bao giờ trỏ nhầm sang kết nối mới ở cùng ô.
+// Bộ nhớ chỉ tăng tới số kết nối đồng thời lớn nhất, không tăng theo số lần kết nối.
+class ConnectionTable
+{
+public:
+    explicit ConnectionTable(size_t capacity);
+
+    ConnectionTable(const ConnectionTable &) = delete;
+    ConnectionTable &operator=(const ConnectionTable &) = delete;
+
+    // Gán conn->id và thêm vào bảng; false (và tăng bộ đếm từ chối) khi đã đầy
+    bool insert(const ConnectionPtr &conn);
+    // false nếu kết nối đã được gỡ trước đó
+    bool remove(const Connection &conn);
+
+    ConnectionPtr find(SOCKET socket) const;
+    ConnectionPtr find(ConnectionId id) const;
+
+    // Kiểm tra nhanh không khóa để từ chối trước khi tạo Connection; insert() mới là quyết định cuối
+    bool full() const { return activeCount() >= m_capacity; }
+    size_t capacity() const { return m_capacity; }
+    size_t activeCount() const { return m_active.load(std::memory_order_relaxed); }
+    uint64_t acceptedCount() const { return m_accepted.load(std::memory_order_relaxed); }
+    uint64_t rejectedCount() const { return m_rejected.load(std::memory_order_relaxed); }
+    void recordRejected() { m_rejected.fetch_add(1, std::memory_order_relaxed); }
+
+private:
+    struct Slot
+    {
+        ConnectionPtr conn;
+        uint32_t generation = 1;
+    };
+
+    const size_t m_capacity;
+    mutable std::mutex m_mutex;
+    std::vector<Slot> m_slots;
+    std::vector<uint32_t> m_freeSlots;
+    // Handler nhận SOCKET nên vẫn cần tra theo số hiệu socket
+    std::unordered_map<SOCKET, uint32_t> m_slotBySocket;
+    std::atomic<size_t> m_active{0};
+    std::atomic<uint64_t> m_accepted{0};
+    std::atomic<uint64_t> m_rejected{0};
+};
+
+#endif // CONNECTIONTABLE_H
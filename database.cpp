@@ -0,0 +1,124 @@
+#include "database.h"
+#include "config.h"
+#include <QDebug>
+#include <QSqlError>
+#include <QString>
+#include <QStringList>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+
+QString threadConnectionName(const std::string &dbName)
+{
+    std::ostringstream oss;
+    oss << dbName << "_" << std::this_thread::get_id();
+    return QString::fromStdString(oss.str());
+}
+
+// Kết nối và các statement đã prepare của một luồng với một file database
+struct ThreadConnection
+{
+    explicit ThreadConnection(const std::string &dbName)
+        : connectionName(threadConnectionName(dbName))
+    {
+        db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+        db.setDatabaseName(QString::fromStdString(dbName));
+        if (!db.open()) {
+            qDebug() << "Failed to open database" << connectionName << ":" << db.lastError().text();
+            return;
+        }
+        configureConnection(db);
+    }
+
+    ~ThreadConnection()
+    {
+        // QSqlQuery và QSqlDatabase phải được giải phóng trước removeDatabase
+        statements.clear();
+        db.close();
+        db = QSqlDatabase();
+        QSqlDatabase::removeDatabase(connectionName);
+    }
+
+    QString connectionName;
+    QSqlDatabase db;
+    // Khóa là địa chỉ của chuỗi SQL (luôn là literal), tra cache không phải dựng
+    // hay băm chuỗi. unordered_map giữ nguyên địa chỉ phần tử khi thêm mới, nên
+    // nhiều PooledQuery có thể lồng nhau trong cùng một luồng
+    std::unordered_map<const char *, QSqlQuery> statements;
+};
+
+ThreadConnection &threadConnection(const std::string &dbName)
+{
+    thread_local std::map<std::string, std::unique_ptr<ThreadConnection>> connections;
+
+    auto it = connections.find(dbName);
+    if (it == connections.end()) {
+        it = connections.emplace(dbName, std::make_unique<ThreadConnection>(dbName)).first;
+    } else if (!it->second->db.isOpen()) {
+        // Lần mở trước thất bại: thử lại với kết nối mới
+        it->second = nullptr;
+        it->second = std::make_unique<ThreadConnection>(dbName);
+    }
+    return *it->second;
+}
+
+} // namespace
+
+void configureConnection(QSqlDatabase &db)
+{
+    const ServerConfig &config = serverConfig();
+    // WAL: người đọc (getFriendsList, getAllMessages) không bị chặn bởi người ghi.
+    // Với WAL, synchronous=NORMAL chỉ fsync lúc checkpoint mà vẫn không hỏng database.
+    QStringList pragmas;
+    pragmas << "PRAGMA journal_mode = WAL;"
+            << "PRAGMA synchronous = NORMAL;"
+            << QString("PRAGMA busy_timeout = %1;").arg(config.dbBusyTimeoutMs)
+            << QString("PRAGMA cache_size = -%1;").arg(config.dbCacheSizeKb)
+            << QString("PRAGMA mmap_size = %1;").arg(config.dbMmapSize)
+            << "PRAGMA temp_store = MEMORY;";
+
+    QSqlQuery query(db);
+    for (const QString &pragma : pragmas) {
+        if (!query.exec(pragma)) {
+            qDebug() << "Failed to apply" << pragma << ":" << query.lastError().text();
+        }
+        query.finish();
+    }
+}
+
+QSqlDatabase &threadDatabase(const std::string &dbName)
+{
+    return threadConnection(dbName).db;
+}
+
+PooledQuery::PooledQuery(const std::string &dbName, const char *sql)
+    : m_query(nullptr)
+{
+    ThreadConnection &conn = threadConnection(dbName);
+    if (!conn.db.isOpen()) {
+        return;
+    }
+
+    auto it = conn.statements.find(sql);
+    if (it == conn.statements.end()) {
+        QSqlQuery query(conn.db);
+        query.setForwardOnly(true);
+        if (!query.prepare(QString::fromUtf8(sql))) {
+            qDebug() << "Failed to prepare statement:" << query.lastError().text();
+            return;
+        }
+        it = conn.statements.emplace(sql, query).first;
+    }
+    m_query = &it->second;
+}
+
+PooledQuery::~PooledQuery()
+{
+    if (m_query) {
+        m_query->finish();
+    }
+}
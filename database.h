@@ -0,0 +1,38 @@
+#ifndef DATABASE_H
+#define DATABASE_H
+
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <string>
+
+// Áp dụng các PRAGMA chung (WAL, synchronous=NORMAL, mmap, cache, busy_timeout)
+// cho một kết nối vừa mở
+void configureConnection(QSqlDatabase &db);
+
+// Kết nối SQLite của luồng hiện tại. Mỗi worker giữ một kết nối mở suốt
+// vòng đời của luồng thay vì addDatabase/open/close cho từng request.
+QSqlDatabase &threadDatabase(const std::string &dbName);
+
+// Câu lệnh đã prepare sẵn, lấy từ cache của luồng hiện tại.
+// Tự gọi finish() khi ra khỏi scope để trả statement về cho lần dùng sau.
+// sql phải là string literal: cache nhận diện câu lệnh theo địa chỉ con trỏ.
+class PooledQuery
+{
+public:
+    PooledQuery(const std::string &dbName, const char *sql);
+    ~PooledQuery();
+
+    PooledQuery(const PooledQuery &) = delete;
+    PooledQuery &operator=(const PooledQuery &) = delete;
+
+    // false nếu không mở được database hoặc câu lệnh không prepare được
+    bool isValid() const { return m_query != nullptr; }
+
+    QSqlQuery *operator->() { return m_query; }
+    QSqlQuery &operator*() { return *m_query; }
+
+private:
+    QSqlQuery *m_query;
+};
+
+#endif // DATABASE_H
@@ -0,0 +1,242 @@
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QSqlError>
+#include <QString>
+#include <algorithm>
+#include "database.h"
+#include "messagewriter.h"
+#include "server.h"
+#include "delivery.h"
+#include "header.h"
+
+QJsonObject ackDelivered(int userID, qint64 messageId, const std::string &dbName);
+
+// Mỗi người dùng có một mốc LastDeliveredID trong DeliveryState: mọi tin gửi tới
+// họ có MessageID <= mốc đã tới client. Receipt của client là lũy kế nên chỉ cần
+// nâng mốc bằng một câu upsert, không update từng dòng của Messages.
+
+static qint64 lastDeliveredId(int userID, const std::string &dbName)
+{
+    PooledQuery query(dbName, "select LastDeliveredID from DeliveryState where UserID = :UserID;");
+    if (!query.isValid()) {
+        return -1;
+    }
+    query->bindValue(":UserID", userID);
+    if (!query->exec()) {
+        qDebug() << "Reading delivery watermark failed:" << query->lastError().text();
+        return -1;
+    }
+    return query->next() ? query->value(0).toLongLong() : 0;
+}
+
+void flushOfflineBacklog(int userID, const ConnectionPtr &conn)
+{
+    // Tin vừa gửi có thể còn trong hàng đợi ghi
+    MessageWriter &writer = Server::getInstance()->getMessageWriter();
+    writer.waitForCommit(writer.lastAllocatedId());
+
+    qint64 cursor = lastDeliveredId(userID, DB_NAME);
+    if (cursor < 0) {
+        return;
+    }
+
+    int total = 0;
+    for (int batch = 0; batch < MAX_BACKLOG_BATCHES; ++batch) {
+        QJsonArray messagesArray;
+        bool hasMore = false;
+        {
+            // Range scan trên (ReceiverID, MessageID)
+            PooledQuery query(DB_NAME,
+                              "select MessageID, SenderID, ReceiverID, Content, SentAt from Messages "
+                              "where ReceiverID = :UserID and MessageID > :Cursor "
+                              "order by MessageID LIMIT :Limit;");
+            if (!query.isValid()) {
+                return;
+            }
+            query->bindValue(":UserID", userID);
+            query->bindValue(":Cursor", cursor);
+            query->bindValue(":Limit", BACKLOG_BATCH_SIZE + 1);
+            if (!query->exec()) {
+                qDebug() << "Reading offline backlog failed:" << query->lastError().text();
+                return;
+            }
+            while (query->next()) {
+                if (messagesArray.size() >= BACKLOG_BATCH_SIZE) {
+                    hasMore = true;
+                    break;
+                }
+                QJsonObject messageObj;
+                cursor = query->value(0).toLongLong();
+                messageObj["messageId"] = cursor;
+                messageObj["senderID"] = query->value(1).toInt();
+                messageObj["receiverID"] = query->value(2).toInt();
+                messageObj["content"] = query->value(3).toString();
+                messageObj["sentAt"] = query->value(4).toString();
+                messagesArray.append(messageObj);
+            }
+        }
+        if (messagesArray.isEmpty()) {
+            break;
+        }
+
+        QJsonObject frame = {{"action", "offlineMessages"},
+                             {"messages", messagesArray},
+                             {"lastMessageId", cursor},
+                             {"hasMore", hasMore}};
+        if (sendJsonResponse(conn, frame) == SOCKET_ERROR) {
+            return;
+        }
+        // Client cũ không bao giờ gửi ackDelivered: nâng mốc ngay để lần đăng nhập sau
+        // không gửi lại cùng backlog
+        if (!conn->deliveryAcks.load()) {
+            ackDelivered(userID, cursor, DB_NAME);
+        }
+        total += messagesArray.size();
+        if (!hasMore) {
+            break;
+        }
+    }
+    if (total > 0) {
+        qDebug() << "Flushed" << total << "offline messages to user" << userID;
+    }
+}
+
+// Nâng mốc đã nhận của userID lên messageId và báo cho người gửi của các tin vừa được nhận
+QJsonObject ackDelivered(int userID, qint64 messageId, const std::string &dbName)
+{
+    QJsonObject result;
+    // Không cho mốc vượt quá ID đã cấp
+    messageId = std::min(messageId, Server::getInstance()->getMessageWriter().lastAllocatedId());
+    qint64 previous = lastDeliveredId(userID, dbName);
+    if (previous < 0) {
+        result["success"] = false;
+        result["message"] = "Database connection error.";
+        return result;
+    }
+    if (messageId <= previous) {
+        result["success"] = true;
+        result["lastDeliveredId"] = previous;
+        return result;
+    }
+
+    {
+        PooledQuery query(dbName,
+                          "insert into DeliveryState (UserID, LastDeliveredID) values (:UserID, :MessageID) "
+                          "on conflict(UserID) do update set "
+                          "LastDeliveredID = max(LastDeliveredID, excluded.LastDeliveredID);");
+        if (!query.isValid()) {
+            result["success"] = false;
+            result["message"] = "Database connection error.";
+            return result;
+        }
+        query->bindValue(":UserID", userID);
+        query->bindValue(":MessageID", messageId);
+        if (!query->exec()) {
+            qDebug() << "Updating delivery watermark failed:" << query->lastError().text();
+            result["success"] = false;
+            result["message"] = "Failed to update delivery state.";
+            return result;
+        }
+    }
+
+    // Một dòng cho mỗi người gửi trong khoảng (previous, messageId]
+    PooledQuery senders(dbName,
+                        "select SenderID, max(MessageID) from Messages "
+                        "where ReceiverID = :UserID and MessageID > :After and MessageID <= :UpTo "
+                        "group by SenderID;");
+    if (senders.isValid()) {
+        senders->bindValue(":UserID", userID);
+        senders->bindValue(":After", previous);
+        senders->bindValue(":UpTo", messageId);
+        if (senders->exec()) {
+            while (senders->next()) {
+                QJsonObject event = {{"action", "messagesDelivered"},
+                                     {"receiverID", userID},
+                                     {"upToMessageId", senders->value(1).toLongLong()}};
+                Server::getInstance()->sendToUser(senders->value(0).toInt(), event);
+            }
+        }
+    }
+
+    result["success"] = true;
+    result["lastDeliveredId"] = messageId;
+    return result;
+}
+
+QJsonObject handleAckDelivered(const Request &request, SOCKET clientSocket)
+{
+    // Mốc thuộc về người đã đăng nhập trên kết nối, không lấy userID từ request
+    int userID = requireSessionUser(clientSocket, "ackDelivered");
+    if (userID == -1) {
+        return {};
+    }
+    qint64 messageId = request["messageId"].toLongLong();
+
+    QJsonObject response = ackDelivered(userID, messageId, DB_NAME);
+    response["action"] = "ackDelivered";
+    sendJsonResponse(clientSocket, response);
+    return response;
+}
+
+// Đánh dấu đã đọc mọi tin từ friendID có MessageID <= messageId (mốc theo từng hội thoại)
+QJsonObject markRead(int userID, int friendID, qint64 messageId, const std::string &dbName)
+{
+    QJsonObject result;
+    // Không cho mốc vượt quá ID đã cấp
+    messageId = std::max<qint64>(0, std::min(messageId, Server::getInstance()->getMessageWriter().lastAllocatedId()));
+    // Chỉ ghi khi mốc tăng: numRowsAffected() = 0 nghĩa là mốc không đổi
+    PooledQuery query(dbName,
+                      "insert into ReadState (UserID, PeerID, LastReadID) values (:UserID, :PeerID, :MessageID) "
+                      "on conflict(UserID, PeerID) do update set LastReadID = excluded.LastReadID "
+                      "where excluded.LastReadID > LastReadID;");
+    if (!query.isValid()) {
+        result["success"] = false;
+        result["message"] = "Database connection error.";
+        return result;
+    }
+
+    query->bindValue(":UserID", userID);
+    query->bindValue(":PeerID", friendID);
+    query->bindValue(":MessageID", messageId);
+
+    if (query->exec()) {
+        result["success"] = true;
+        result["changed"] = messageId > 0 && query->numRowsAffected() > 0;
+        result["friendID"] = friendID;
+        result["lastReadId"] = messageId;
+    } else {
+        qDebug() << "Updating read watermark failed:" << query->lastError().text();
+        result["success"] = false;
+        result["message"] = "Failed to update read state.";
+    }
+    return result;
+}
+
+QJsonObject handleMarkRead(const Request &request, SOCKET clientSocket)
+{
+    int userID = requireSessionUser(clientSocket, "markRead");
+    if (userID == -1) {
+        return {};
+    }
+    int friendID = request["friendID"].toInt();
+    qint64 messageId = request["messageId"].toLongLong();
+
+    QJsonObject response = markRead(userID, friendID, messageId, DB_NAME);
+    response["action"] = "markRead";
+    sendJsonResponse(clientSocket, response);
+
+    if (response["changed"].toBool()) {
+        QJsonObject event = {{"action", "messagesRead"},
+                             {"readerID", userID},
+                             {"upToMessageId", response["lastReadId"]}};
+        Server::getInstance()->sendToUser(friendID, event);
+    }
+    return response;
+}
+
+void initDeliveryHandlers(HandlerTable &handlers)
+{
+    handlers.add(Opcode::AckDelivered, handleAckDelivered);
+    handlers.add(Opcode::MarkRead, handleMarkRead);
+}
@@ -0,0 +1,23 @@
+#ifndef DELIVERY_H
+#define DELIVERY_H
+
+#include <map>
+#include <functional>
+#include <QString>
+#include <QJsonObject>
+#include "handlertable.h"
+#include "connection.h"
+#include "platform.h"
+
+#define BACKLOG_BATCH_SIZE 200
+#define MAX_BACKLOG_BATCHES 10
+
+// Gửi các tin nhắn đến trong lúc userID offline (MessageID > mốc đã nhận) thành
+// từng frame "offlineMessages" tối đa BACKLOG_BATCH_SIZE tin. Dừng sau
+// MAX_BACKLOG_BATCHES frame, phần còn lại client lấy bằng syncMessages.
+// Kết nối không bật deliveryAcks (client cũ) được coi là đã nhận mỗi frame gửi thành công.
+void flushOfflineBacklog(int userID, const ConnectionPtr &conn);
+
+void initDeliveryHandlers(HandlerTable &handlers);
+
+#endif // DELIVERY_H
@@ -1,119 +1,271 @@
 #include <QDebug>
 #include <QJsonObject>
 #include <QJsonArray>
-#include <QSqlDatabase>
 #include <QSqlError>
-#include <QSqlQuery>
 #include <QString>
+#include <QDateTime>
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include "config.h"
+#include "database.h"
+#include "messagewriter.h"
 #include "server.h"
 #include "friend.h"
 #include "header.h"
 
-QJsonObject sendMessage(const int &senderID, const int &receiverID, const QString &content, const std::string &dbName)
+QJsonObject handleSendMessage(const Request &request, SOCKET clientSocket)
 {
-    QJsonObject result;
-    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "InsertMessageConnection");
-    db.setDatabaseName(QString::fromStdString(dbName));
+    int senderID = request["senderID"].toInt();
+    int receiverID = request["receiverID"].toInt();
+    QString content = request["content"].toString();
+    QString sentAt = QDateTime::currentDateTimeUtc().toString("yyyy-MM-dd HH:mm:ss");
+
+    QJsonObject response = {{"action", "sendMessage"}, {"sentAt", sentAt}};
+    if (request.contains("clientMessageId")) {
+        response["clientMessageId"] = request["clientMessageId"].toJsonValue();
+    }
+    // Content null sẽ vi phạm NOT NULL khi ghi: từ chối trước khi tin được cấp ID
+    if (!request["content"].isString()) {
+        response["success"] = false;
+        response["message"] = "Message content must be a string.";
+        sendJsonResponse(clientSocket, response);
+        return response;
+    }
+
+    // Tin được cấp ID và giao ngay cho người nhận, việc ghi database chạy nền theo lô
+    MessageWriter &writer = Server::getInstance()->getMessageWriter();
+    MessageWriter::CommitCallback onCommitted;
+    if (serverConfig().ackAfterCommit) {
+        ConnectionPtr sender = Server::getInstance()->findConnection(clientSocket);
+        onCommitted = [sender, response](qint64 messageId, bool ok) mutable {
+            response["success"] = ok;
+            response["message"] = ok ? "Message inserted successfully." : "Failed to insert message.";
+            response["messageId"] = messageId;
+            response["durable"] = ok;
+            if (sender) {
+                sendJsonResponse(sender, response);
+            }
+        };
+    }
+    qint64 messageId = writer.enqueue(senderID, receiverID, content, sentAt, std::move(onCommitted));
+
+    if (!serverConfig().ackAfterCommit) {
+        response["success"] = true;
+        response["message"] = "Message queued.";
+        response["messageId"] = messageId;
+        response["durable"] = false;
+        sendJsonResponse(clientSocket, response);
+    }
+
+    // Giao cho mọi phiên đang online của người nhận
+    if (Server::getInstance()->isUserOnline(receiverID)) {
+        QJsonObject forwardMessage = request.toJsonObject();
+        forwardMessage["action"] = "receiveMessage";
+        forwardMessage["messageId"] = messageId;
+        forwardMessage["sentAt"] = sentAt;
+        Server::getInstance()->sendToUser(receiverID, forwardMessage); // Forward the message to the receiver
+    }
+    qDebug() << "Queued message" << messageId << "from" << senderID << "to" << receiverID;
+    return {};
+}
+
+// Trạng thái lấy từ PresenceRegistry trong bộ nhớ thay vì cột Users.Status
+static int presenceStatus(int userID)
+{
+    return Server::getInstance()->isUserOnline(userID) ? 1 : 0;
+}
+
+// Thông tin một người dùng kèm trạng thái online, dùng trong các sự kiện đẩy tới client
+static QJsonObject userToJson(int userID)
+{
+    QJsonObject userObj;
+    userObj["userID"] = userID;
+    userObj["username"] = Server::getInstance()->getFriendGraph().username(userID);
+    userObj["status"] = presenceStatus(userID);
+    return userObj;
+}
 
-    if (!db.open()) {
-        qDebug() << "Failed to open database for inserting message:" << db.lastError().text();
+static QJsonArray usersToJson(const std::vector<UserEntry> &users)
+{
+    QJsonArray usersArray;
+    for (const UserEntry &user : users) {
+        QJsonObject userObj;
+        userObj["userID"] = user.userId;
+        userObj["username"] = user.username;
+        userObj["status"] = presenceStatus(user.userId);
+        usersArray.append(userObj);
+    }
+    return usersArray;
+}
+
+#define DEFAULT_HISTORY_PAGE_SIZE 50
+#define MAX_HISTORY_PAGE_SIZE 200
+
+// Tin vừa gửi có thể còn trong hàng đợi ghi: chờ lô hiện tại commit rồi mới đọc
+static void waitForPendingMessages()
+{
+    MessageWriter &writer = Server::getInstance()->getMessageWriter();
+    writer.waitForCommit(writer.lastAllocatedId());
+}
+
+static int clampPageSize(const Request &request)
+{
+    int pageSize = request["pageSize"].toInt(DEFAULT_HISTORY_PAGE_SIZE);
+    return std::min(std::max(pageSize, 1), MAX_HISTORY_PAGE_SIZE);
+}
+
+// Đọc các cột MessageID, SenderID, ReceiverID, Content, SentAt của dòng hiện tại
+static QJsonObject messageFromQuery(QSqlQuery &query)
+{
+    QJsonObject messageObj;
+    messageObj["messageId"] = query.value(0).toLongLong();
+    messageObj["senderID"] = query.value(1).toInt();
+    messageObj["receiverID"] = query.value(2).toInt();
+    messageObj["content"] = query.value(3).toString();
+    messageObj["sentAt"] = query.value(4).toString();
+    return messageObj;
+}
+
+// Một trang lịch sử giữa hai người dùng, phân trang theo MessageID (keyset) thay vì OFFSET:
+// - afterMessageId > 0: các tin mới hơn cursor, tăng dần
+// - ngược lại: các tin cũ hơn beforeMessageId (0 = trang mới nhất)
+// Mỗi trang là một range scan trên (ConversationKey, MessageID) nên trang thứ 500 cũng rẻ như trang đầu.
+// Lấy thêm một dòng để biết còn trang tiếp theo hay không.
+QJsonObject getMessageHistory(int userID,
+                              int friendID,
+                              qint64 beforeMessageId,
+                              qint64 afterMessageId,
+                              int pageSize,
+                              const std::string &dbName)
+{
+    QJsonObject result;
+    waitForPendingMessages();
+
+    bool forward = afterMessageId > 0;
+    PooledQuery query(dbName,
+                      forward ? "select MessageID, SenderID, ReceiverID, Content, SentAt from Messages "
+                                "where ConversationKey = :ConversationKey and MessageID > :Cursor "
+                                "order by MessageID asc LIMIT :Limit;"
+                              : "select MessageID, SenderID, ReceiverID, Content, SentAt from Messages "
+                                "where ConversationKey = :ConversationKey and MessageID < :Cursor "
+                                "order by MessageID desc LIMIT :Limit;");
+    if (!query.isValid()) {
         result["success"] = false;
         result["message"] = "Database connection error.";
         return result;
     }
 
-    QSqlQuery query(db);
-    query.prepare(
-        "insert into Messages (SenderID, ReceiverID, Content) values (:SenderID, :ReceiverID, :Content);");
-    query.bindValue(":SenderID", senderID);
-    query.bindValue(":ReceiverID", receiverID);
-    query.bindValue(":Content", content);
+    qint64 cursor = forward ? afterMessageId
+                            : (beforeMessageId > 0 ? beforeMessageId : std::numeric_limits<qint64>::max());
+    query->bindValue(":ConversationKey", conversationKey(userID, friendID));
+    query->bindValue(":Cursor", cursor);
+    query->bindValue(":Limit", pageSize + 1);
 
-    if (!query.exec()) {
-        qDebug() << "Inserting message failed:" << query.lastError().text();
-        db.close();
-        QSqlDatabase::removeDatabase("InsertMessageConnection");
+    if (!query->exec()) {
+        qDebug() << "Returning messages failed:" << query->lastError().text();
         result["success"] = false;
-        result["message"] = "Failed to insert message.";
+        result["message"] = "Failed to retrieve messages.";
         return result;
     }
 
-    db.close();
-    QSqlDatabase::removeDatabase("InsertMessageConnection");
+    std::vector<QJsonObject> rows;
+    while (query->next()) {
+        rows.push_back(messageFromQuery(*query));
+    }
+    bool hasMore = rows.size() > static_cast<size_t>(pageSize);
+    if (hasMore) {
+        rows.pop_back();
+    }
+    // Luôn trả về theo thứ tự thời gian
+    if (!forward) {
+        std::reverse(rows.begin(), rows.end());
+    }
+
+    QJsonArray messagesArray;
+    for (const QJsonObject &row : rows) {
+        messagesArray.append(row);
+    }
     result["success"] = true;
-    result["message"] = "Message inserted successfully.";
+    result["messages"] = messagesArray;
+    result["hasMore"] = hasMore;
+    if (!rows.empty()) {
+        // Cursor cho trang cũ hơn / mới hơn tiếp theo
+        result["oldestMessageId"] = rows.front()["messageId"];
+        result["newestMessageId"] = rows.back()["messageId"];
+    }
     return result;
 }
 
-QJsonObject handleSendMessage(const QJsonObject &request, SOCKET clientSocket)
+// Lấy trang tin nhắn mới nhất giữa hai người dùng
+QJsonObject getAllMessages(int userID, int friendID, const std::string &dbName)
 {
-    int senderID = request["senderID"].toInt();
-    int receiverID = request["receiverID"].toInt();
-    QString content = request["content"].toString();
-
-    QJsonObject response = sendMessage(senderID, receiverID, content, DB_NAME);
-    response["action"] = "sendMessage";
-    sendJsonResponse(clientSocket, response);
-    
-    SOCKET targetSocket = Server::getInstance()->getUserSocket(receiverID);
-    if (targetSocket != 0) {
-        QJsonObject forwardMessage = request;
-        forwardMessage["action"] = "receiveMessage";
-        sendJsonResponse(targetSocket, forwardMessage); // Forward the message to the receiver
-    }
-    qDebug() << "Sent insert message response to client.";
-    return {};
+    return getMessageHistory(userID, friendID, 0, 0, 20, dbName);
 }
 
-// Lấy toàn bộ tin nhắn giữa hai người dùng
-QJsonObject getAllMessages(int userID, int friendID, const std::string &dbName)
+// Mọi tin gửi đến hoặc gửi đi của userID có MessageID > afterMessageId, tăng dần.
+// Client kết nối lại chỉ cần gửi ID lớn nhất đã thấy để lấy phần chênh lệch.
+// Hai nhánh UNION ALL là hai range scan trên (ReceiverID, MessageID) và (SenderID, MessageID),
+// mỗi nhánh tự dừng sau Limit dòng.
+QJsonObject syncMessages(int userID, qint64 afterMessageId, int pageSize, const std::string &dbName)
 {
     QJsonObject result;
-    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "ReturnMessagesConnection");
-    db.setDatabaseName(QString::fromStdString(dbName));
-
-    if (!db.open()) {
-        qDebug() << "Failed to open database for returning messages:" << db.lastError().text();
+    waitForPendingMessages();
+
+    PooledQuery query(dbName,
+                      "select MessageID, SenderID, ReceiverID, Content, SentAt from ("
+                      "select * from (select MessageID, SenderID, ReceiverID, Content, SentAt from Messages "
+                      "where ReceiverID = :UserID and MessageID > :Cursor "
+                      "order by MessageID LIMIT :Limit) "
+                      "union all "
+                      "select * from (select MessageID, SenderID, ReceiverID, Content, SentAt from Messages "
+                      "where SenderID = :UserID and ReceiverID != :UserID and MessageID > :Cursor "
+                      "order by MessageID LIMIT :Limit)"
+                      ") order by MessageID LIMIT :Limit;");
+    if (!query.isValid()) {
         result["success"] = false;
         result["message"] = "Database connection error.";
         return result;
     }
 
-    QSqlQuery query(db);
-    query.prepare(
-        "select SenderID, ReceiverID, Content, SentAt from Messages "
-        "where (SenderID = :UserID and ReceiverID = :FriendID) "
-        "or (SenderID = :FriendID and ReceiverID = :UserID) "
-        "order by SentAt ASC LIMIT 20;");
-    query.bindValue(":UserID", userID);
-    query.bindValue(":FriendID", friendID);
+    query->bindValue(":UserID", userID);
+    query->bindValue(":Cursor", afterMessageId);
+    query->bindValue(":Limit", pageSize + 1);
 
-    QJsonArray messagesArray;
-    if (query.exec()) {
-        while (query.next()) {
-            QJsonObject messageObj;
-            messageObj["senderID"] = query.value(0).toInt();
-            messageObj["receiverID"] = query.value(1).toInt();
-            messageObj["content"] = query.value(2).toString();
-            messageObj["sentAt"] = query.value(3).toString();
-            messagesArray.append(messageObj);
-        }
-        result["success"] = true;
-        result["messages"] = messagesArray;
-    } else {
-        qDebug() << "Returning messages failed:" << query.lastError().text();
+    if (!query->exec()) {
+        qDebug() << "Syncing messages failed:" << query->lastError().text();
         result["success"] = false;
-        result["message"] = "Failed to retrieve messages.";
+        result["message"] = "Failed to sync messages.";
+        return result;
     }
 
-    db.close();
-    QSqlDatabase::removeDatabase("ReturnMessagesConnection");
+    QJsonArray messagesArray;
+    bool hasMore = false;
+    qint64 lastMessageId = afterMessageId;
+    while (query->next()) {
+        if (messagesArray.size() >= pageSize) {
+            hasMore = true;
+            break;
+        }
+        QJsonObject messageObj = messageFromQuery(*query);
+        lastMessageId = messageObj["messageId"].toVariant().toLongLong();
+        messagesArray.append(messageObj);
+    }
+    result["success"] = true;
+    result["messages"] = messagesArray;
+    result["hasMore"] = hasMore;
+    // Gửi lại giá trị này ở lần sync sau
+    result["lastMessageId"] = lastMessageId;
     return result;
 }
 
-QJsonObject handleGetAllMessages(const QJsonObject &request, SOCKET clientSocket)
+QJsonObject handleGetAllMessages(const Request &request, SOCKET clientSocket)
 {
-    int userID = request["userID"].toInt();
+    // Trả cùng trang hội thoại như getMessageHistory nên cũng chỉ cho người đã đăng nhập
+    int userID = requireSessionUser(clientSocket, "getAllMessages");
+    if (userID == -1) {
+        return {};
+    }
     int friendID = request["friendID"].toInt();
 
     QJsonObject response = getAllMessages(userID, friendID, DB_NAME);
@@ -123,109 +275,108 @@ QJsonObject handleGetAllMessages(const QJsonObject &request, SOCKET clientSocket
     return response;
 }
 
-QJsonObject getAllUsers(const std::string &dbName)
+QJsonObject handleGetMessageHistory(const Request &request, SOCKET clientSocket)
 {
-    QJsonObject result;
-    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "ReturnUsersConnection");
-    db.setDatabaseName(QString::fromStdString(dbName));
-
-    if (!db.open()) {
-        qDebug() << "Failed to open database for returning users:" << db.lastError().text();
-        result["success"] = false;
-        result["message"] = "Database connection error.";
-        return result;
+    // Chỉ đọc hội thoại của chính người đã đăng nhập trên kết nối này
+    int userID = requireSessionUser(clientSocket, "getMessageHistory");
+    if (userID == -1) {
+        return {};
     }
+    int friendID = request["friendID"].toInt();
+    qint64 beforeMessageId = request["beforeMessageId"].toLongLong();
+    qint64 afterMessageId = request["afterMessageId"].toLongLong();
 
-    QSqlQuery query(db);
-    query.prepare("select UserID, Username, Status from Users;");
+    QJsonObject response = getMessageHistory(userID, friendID, beforeMessageId, afterMessageId,
+                                             clampPageSize(request), DB_NAME);
+    response["action"] = "getMessageHistory";
+    response["friendID"] = friendID;
+    sendJsonResponse(clientSocket, response);
+    qDebug() << "Sent message history response to client.";
+    return response;
+}
 
-    QJsonArray usersArray;
-    if (query.exec()) {
-        while (query.next()) {
-            QJsonObject userObj;
-            userObj["userID"] = query.value(0).toInt();
-            userObj["username"] = query.value(1).toString();
-            userObj["status"] = query.value(2).toInt();
-            usersArray.append(userObj);
-        }
-        result["success"] = true;
-        result["users"] = usersArray;
-    } else {
-        qDebug() << "Returning users failed:" << query.lastError().text();
-        result["success"] = false;
-        result["message"] = "Failed to retrieve users.";
+QJsonObject handleSyncMessages(const Request &request, SOCKET clientSocket)
+{
+    int userID = requireSessionUser(clientSocket, "syncMessages");
+    if (userID == -1) {
+        return {};
     }
+    qint64 afterMessageId = request["afterMessageId"].toLongLong();
+
+    QJsonObject response = syncMessages(userID, afterMessageId, clampPageSize(request), DB_NAME);
+    response["action"] = "syncMessages";
+    sendJsonResponse(clientSocket, response);
+    qDebug() << "Sent sync messages response to client.";
+    return response;
+}
 
-    db.close();
-    QSqlDatabase::removeDatabase("ReturnUsersConnection");
+QJsonObject getAllUsers()
+{
+    QJsonObject result;
+    result["success"] = true;
+    result["users"] = usersToJson(Server::getInstance()->getFriendGraph().allUsers());
     return result;
 }
 
-QJsonObject handleGetAllUsers(const QJsonObject &request, SOCKET clientSocket)
+QJsonObject handleGetAllUsers(const Request &request, SOCKET clientSocket)
 {
-    QJsonObject response = getAllUsers(DB_NAME);
+    QJsonObject response = getAllUsers();
     response["action"] = "getAllUsers";
     sendJsonResponse(clientSocket, response);
     qDebug() << "Sent return all users response to client.";
     return response;
 }
 
-QJsonObject getNonFriendUsers(int userID, const std::string &dbName)
+#define DEFAULT_SEARCH_PAGE_SIZE 20
+#define MAX_SEARCH_PAGE_SIZE 100
+
+// Tìm người dùng theo tiền tố username, trả về từng trang kèm cursor (nextAfterUserID)
+QJsonObject searchUsers(int userID, const QString &prefix, int afterUserID, int pageSize, bool nonFriendsOnly)
 {
     QJsonObject result;
-    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "GetNonFriendUsersConnection");
-    db.setDatabaseName(QString::fromStdString(dbName));
-
-    if (!db.open()) {
-        qDebug() << "Failed to open database for getting non-friend users:" << db.lastError().text();
-        result["success"] = false;
-        result["message"] = "Database connection error.";
-        return result;
+    bool hasMore = false;
+    std::vector<UserEntry> users = Server::getInstance()->getFriendGraph().searchUsers(
+        userID, prefix, afterUserID, pageSize, nonFriendsOnly, hasMore);
+    result["success"] = true;
+    result["users"] = usersToJson(users);
+    result["hasMore"] = hasMore;
+    if (hasMore) {
+        result["nextAfterUserID"] = users.back().userId;
     }
+    return result;
+}
 
-    QSqlQuery query(db);
-    // Select users who are NOT the current user AND NOT in the Friendships table with Status = 1 (Friends)
-    // This includes Strangers and Pending Requests (Incoming/Outgoing)
-    query.prepare(
-        "SELECT u.UserID, u.Username, u.Status "
-        "FROM Users u "
-        "WHERE u.UserID != :UserID "
-        "AND NOT EXISTS ("
-        "   SELECT 1 FROM Friendships f "
-        "   WHERE ((f.UserID1 = u.UserID AND f.UserID2 = :UserID) "
-        "      OR (f.UserID1 = :UserID AND f.UserID2 = u.UserID)) "
-        "   AND f.Status = 1"
-        ");");
-    query.bindValue(":UserID", userID);
-
-    QJsonArray usersArray;
-    if (query.exec()) {
-        while (query.next()) {
-            QJsonObject userObj;
-            userObj["userID"] = query.value(0).toInt();
-            userObj["username"] = query.value(1).toString();
-            userObj["status"] = query.value(2).toInt();
-            // userObj["sentRequest"] is no longer needed as we filter them out
-            usersArray.append(userObj);
-        }
-        result["success"] = true;
-        result["users"] = usersArray;
-    } else {
-        qDebug() << "Getting non-friend users failed:" << query.lastError().text();
-        result["success"] = false;
-        result["message"] = "Failed to retrieve non-friend users.";
-    }
+QJsonObject handleSearchUsers(const Request &request, SOCKET clientSocket)
+{
+    int userID = request["userID"].toInt();
+    QString prefix = request["query"].toString();
+    int afterUserID = request["afterUserID"].toInt();
+    int pageSize = request["pageSize"].toInt(DEFAULT_SEARCH_PAGE_SIZE);
+    pageSize = std::min(std::max(pageSize, 1), MAX_SEARCH_PAGE_SIZE);
+    bool nonFriendsOnly = request["nonFriendsOnly"].toBool();
+
+    QJsonObject response = searchUsers(userID, prefix, afterUserID, pageSize, nonFriendsOnly);
+    response["action"] = "searchUsers";
+    response["query"] = prefix;
+    sendJsonResponse(clientSocket, response);
+    qDebug() << "Sent search users response to client.";
+    return response;
+}
 
-    db.close();
-    QSqlDatabase::removeDatabase("GetNonFriendUsersConnection");
+QJsonObject getNonFriendUsers(int userID)
+{
+    QJsonObject result;
+    // Người dùng khác userID chưa là bạn, gồm cả người lạ và lời mời đang chờ (hai chiều)
+    result["success"] = true;
+    result["users"] = usersToJson(Server::getInstance()->getFriendGraph().nonFriends(userID));
     return result;
 }
 
-QJsonObject handleGetNonFriendUsers(const QJsonObject &request, SOCKET clientSocket)
+QJsonObject handleGetNonFriendUsers(const Request &request, SOCKET clientSocket)
 {
     int userID = request["userID"].toInt();
 
-    QJsonObject response = getNonFriendUsers(userID, DB_NAME);
+    QJsonObject response = getNonFriendUsers(userID);
     response["action"] = "getNonFriendUsers";
     int sent = sendJsonResponse(clientSocket, response);
     if (sent != SOCKET_ERROR) {
@@ -234,55 +385,20 @@ QJsonObject handleGetNonFriendUsers(const QJsonObject &request, SOCKET clientSoc
     return response;
 }
 
-QJsonObject getFriendRequests(int userID, const std::string &dbName)
+QJsonObject getFriendRequests(int userID)
 {
     QJsonObject result;
-    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "GetFriendRequestsConnection");
-    db.setDatabaseName(QString::fromStdString(dbName));
-
-    if (!db.open()) {
-        qDebug() << "Failed to open database for getting friend requests:" << db.lastError().text();
-        result["success"] = false;
-        result["message"] = "Database connection error.";
-        return result;
-    }
-
-    QSqlQuery query(db);
-    // Select users who sent me a friend request (Incoming Pending)
-    query.prepare(
-        "SELECT u.UserID, u.Username, u.Status "
-        "FROM Users u "
-        "JOIN Friendships f ON u.UserID = f.UserID1 "
-        "WHERE f.UserID2 = :UserID AND f.Status = 0;");
-    query.bindValue(":UserID", userID);
-
-    QJsonArray usersArray;
-    if (query.exec()) {
-        while (query.next()) {
-            QJsonObject userObj;
-            userObj["userID"] = query.value(0).toInt();
-            userObj["username"] = query.value(1).toString();
-            userObj["status"] = query.value(2).toInt();
-            usersArray.append(userObj);
-        }
-        result["success"] = true;
-        result["requests"] = usersArray;
-    } else {
-        qDebug() << "Getting friend requests failed:" << query.lastError().text();
-        result["success"] = false;
-        result["message"] = "Failed to retrieve friend requests.";
-    }
-
-    db.close();
-    QSqlDatabase::removeDatabase("GetFriendRequestsConnection");
+    // Những người đã gửi lời mời cho userID (lời mời đến, đang chờ)
+    result["success"] = true;
+    result["requests"] = usersToJson(Server::getInstance()->getFriendGraph().incomingRequests(userID));
     return result;
 }
 
-QJsonObject handleGetFriendRequests(const QJsonObject &request, SOCKET clientSocket)
+QJsonObject handleGetFriendRequests(const Request &request, SOCKET clientSocket)
 {
     int userID = request["userID"].toInt();
 
-    QJsonObject response = getFriendRequests(userID, DB_NAME);
+    QJsonObject response = getFriendRequests(userID);
     response["action"] = "getFriendRequests";
     sendJsonResponse(clientSocket, response);
     qDebug() << "Sent get friend requests response to client.";
@@ -292,200 +408,147 @@ QJsonObject handleGetFriendRequests(const QJsonObject &request, SOCKET clientSoc
 QJsonObject friendRequest(const int &fromUserID, const int &toUserID, const std::string &dbName)
 {
     QJsonObject result;
-    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "FriendRequestConnection");
-    db.setDatabaseName(QString::fromStdString(dbName));
-    if (!db.open()) {
-        qDebug() << "Failed to open database for friend request:" << db.lastError().text();
+    FriendGraph &graph = Server::getInstance()->getFriendGraph();
+    if (!graph.hasUser(fromUserID) || !graph.hasUser(toUserID) || fromUserID == toUserID) {
+        result["success"] = false;
+        result["message"] = fromUserID == toUserID ? "Cannot send a friend request to yourself."
+                                                   : "User does not exist.";
+        return result;
+    }
+
+    PooledQuery query(dbName,
+                      "insert into Friendships (UserID1, UserID2, Status) values (:UserID1, :UserID2, 0);");
+    if (!query.isValid()) {
         result["success"] = false;
         result["message"] = "Database connection error.";
         return result;
     }
 
-    QSqlQuery query(db);
-    query.prepare(
-        "insert into Friendships (UserID1, UserID2, Status) values (:UserID1, :UserID2, 0);");
-    query.bindValue(":UserID1", fromUserID);
-    query.bindValue(":UserID2", toUserID);
+    query->bindValue(":UserID1", fromUserID);
+    query->bindValue(":UserID2", toUserID);
 
-    if (query.exec()) {
+    if (query->exec() && query->numRowsAffected() > 0) {
+        graph.addRequest(fromUserID, toUserID);
         result["success"] = true;
         result["message"] = "Friend request sent successfully.";
     } else {
-        qDebug() << "Friend request failed:" << query.lastError().text();
+        qDebug() << "Friend request failed:" << query->lastError().text();
         result["success"] = false;
         result["message"] = "Failed to send friend request.";
     }
 
-    db.close();
-    QSqlDatabase::removeDatabase("FriendRequestConnection");
     return result;
 }
 
-QJsonObject handleFriendRequest(const QJsonObject &request, SOCKET clientSocket)
+QJsonObject handleFriendRequest(const Request &request, SOCKET clientSocket)
 {
     int fromUserID = request["fromUserID"].toInt();
     int toUserID = request["toUserID"].toInt();
 
     QJsonObject response = friendRequest(fromUserID, toUserID, DB_NAME);
     response["action"] = "friendRequest";
-    // sendJsonResponse(clientSocket, response);
-    // người dùng tải lại danh sách bạn bè là thấy kết quả
+    response["toUserID"] = toUserID;
+    sendJsonResponse(clientSocket, response);
     qDebug() << "Sent friend request response to client.";
+
+    if (response["success"].toBool()) {
+        // Người nhận thấy lời mời ngay, không phải gọi lại getFriendRequests
+        QJsonObject event = {{"action", "friendRequestReceived"}, {"from", userToJson(fromUserID)}};
+        Server::getInstance()->sendToUser(toUserID, event);
+    }
     return response;
 }
 
 QJsonObject acceptFriendRequest(const int &fromUserID, const int &toUserID, const std::string &dbName)
 {
     QJsonObject result;
-    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "AcceptFriendRequestConnection");
-    db.setDatabaseName(QString::fromStdString(dbName));
-    if (!db.open()) {
-        qDebug() << "Failed to open database for accepting friend request:" << db.lastError().text();
+    PooledQuery query(dbName,
+                      "update Friendships set Status = 1 "
+                      "where (UserID1 = :UserID1 and UserID2 = :UserID2) "
+                      "or (UserID1 = :UserID2 and UserID2 = :UserID1);");
+    if (!query.isValid()) {
         result["success"] = false;
         result["message"] = "Database connection error.";
         return result;
     }
 
-    QSqlQuery query(db);
-    query.prepare(
-        "update Friendships set Status = 1 "
-        "where (UserID1 = :UserID1 and UserID2 = :UserID2) "
-        "or (UserID1 = :UserID2 and UserID2 = :UserID1);");
-    query.bindValue(":UserID1", fromUserID);
-    query.bindValue(":UserID2", toUserID);
+    query->bindValue(":UserID1", fromUserID);
+    query->bindValue(":UserID2", toUserID);
 
-    if (query.exec()) {
+    if (query->exec()) {
+        // Không có lời mời nào giữa hai người thì database không đổi, graph cũng vậy
+        if (query->numRowsAffected() > 0) {
+            Server::getInstance()->getFriendGraph().acceptRequest(fromUserID, toUserID);
+        }
         result["success"] = true;
         result["message"] = "Friend request accepted successfully.";
     } else {
-        qDebug() << "Accepting friend request failed:" << query.lastError().text();
+        qDebug() << "Accepting friend request failed:" << query->lastError().text();
         result["success"] = false;
         result["message"] = "Failed to accept friend request.";
     }
 
-    db.close();
-    QSqlDatabase::removeDatabase("AcceptFriendRequestConnection");
     return result;
 }
 
-QJsonObject queryFriendStatus(const int &fromUserID, const int &toUserID, const std::string &dbName)
+QJsonObject queryFriendStatus(const int &fromUserID, const int &toUserID)
 {
     QJsonObject result;
-    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "QueryFriendStatusConnection");
-    db.setDatabaseName(QString::fromStdString(dbName));
-    if (!db.open()) {
-        qDebug() << "Failed to open database for querying friend status:" << db.lastError().text();
-        result["success"] = false;
-        result["message"] = "Database connection error.";
-        return result;
-    }
-
-    QSqlQuery query(db);
-    query.prepare(
-        "select Status, UserID1 from Friendships "
-        "where (UserID1 = :UserID1 and UserID2 = :UserID2) "
-        "or (UserID1 = :UserID2 and UserID2 = :UserID1);");
-    query.bindValue(":UserID1", fromUserID);
-    query.bindValue(":UserID2", toUserID);
-
-    if (query.exec() && query.next()) {
-        result["success"] = true;
-        int status = query.value(0).toInt();
-        int sender = query.value(1).toInt();
-        
-        if (status == 0) {
-            // If pending, check who sent it
-            if (sender == fromUserID) {
-                result["status"] = 0; // I sent it
-            } else {
-                result["status"] = 2; // They sent it (Incoming request)
-            }
-        } else {
-            result["status"] = 1; // Friends
-        }
-    } else {
-        result["success"] = true;
-        result["status"] = -1; // Not friends
-    }
-
-    db.close();
-    QSqlDatabase::removeDatabase("QueryFriendStatusConnection");
+    // -1: chưa là bạn, 0: fromUserID đã gửi lời mời, 1: bạn bè, 2: toUserID đã gửi lời mời
+    FriendStatus status = Server::getInstance()->getFriendGraph().status(fromUserID, toUserID);
+    result["success"] = true;
+    result["status"] = static_cast<int>(status);
     return result;
 }
 
-QJsonObject handleQueryFriendStatus(const QJsonObject &request, SOCKET clientSocket)
+QJsonObject handleQueryFriendStatus(const Request &request, SOCKET clientSocket)
 {
     int fromUserID = request["fromUserID"].toInt();
     int toUserID = request["toUserID"].toInt();
 
-    QJsonObject response = queryFriendStatus(fromUserID, toUserID, DB_NAME);
+    QJsonObject response = queryFriendStatus(fromUserID, toUserID);
     response["action"] = "queryFriendStatus";
     sendJsonResponse(clientSocket, response);
     qDebug() << "Sent query friend status response to client.";
     return response;
 }
 
-QJsonObject handleAcceptFriendRequest(const QJsonObject &request, SOCKET clientSocket)
+QJsonObject handleAcceptFriendRequest(const Request &request, SOCKET clientSocket)
 {
     int fromUserID = request["fromUserID"].toInt();
     int toUserID = request["toUserID"].toInt();
 
     QJsonObject response = acceptFriendRequest(fromUserID, toUserID, DB_NAME);
     response["action"] = "acceptFriendRequest";
-    // sendJsonResponse(clientSocket, response);
-    // khi người dùng chấp nhận thì render mới luôn
+    bool accepted = response["success"].toBool()
+                    && Server::getInstance()->getFriendGraph().status(fromUserID, toUserID) == FriendStatus::Friends;
+    if (accepted) {
+        // Kèm thông tin bạn mới (cả trạng thái online) để client render luôn
+        response["friend"] = userToJson(toUserID);
+    }
+    sendJsonResponse(clientSocket, response);
     qDebug() << "Sent accept friend request response to client.";
+
+    if (accepted) {
+        QJsonObject event = {{"action", "friendRequestAccepted"}, {"friend", userToJson(fromUserID)}};
+        Server::getInstance()->sendToUser(toUserID, event);
+    }
     return response;
 }
 
-QJsonObject getFriendsList(const int &userID, const std::string &dbName)
+QJsonObject getFriendsList(const int &userID)
 {
     QJsonObject result;
-    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "GetFriendsListConnection");
-    db.setDatabaseName(QString::fromStdString(dbName));
-
-    if (!db.open()) {
-        qDebug() << "Failed to open database for getting friends list:" << db.lastError().text();
-        result["success"] = false;
-        result["message"] = "Database connection error.";
-        return result;
-    }
-
-    QSqlQuery query(db);
-    query.prepare(
-        "SELECT u.UserID, u.Username, u.Status "
-        "FROM Users u "
-        "JOIN Friendships f ON (u.UserID = f.UserID1 OR u.UserID = f.UserID2) "
-        "WHERE (f.UserID1 = :UserID OR f.UserID2 = :UserID) AND f.Status = 1 AND u.UserID != :UserID;");
-    query.bindValue(":UserID", userID);
-
-    QJsonArray friendsArray;
-    if (query.exec()) {
-        while (query.next()) {
-            QJsonObject friendObj;
-            friendObj["userID"] = query.value(0).toInt();
-            friendObj["username"] = query.value(1).toString();
-            friendObj["status"] = query.value(2).toInt();
-            friendsArray.append(friendObj);
-        }
-        result["success"] = true;
-        result["friends"] = friendsArray;
-    } else {
-        qDebug() << "Getting friends list failed:" << query.lastError().text();
-        result["success"] = false;
-        result["message"] = "Failed to retrieve friends list.";
-    }
-
-    db.close();
-    QSqlDatabase::removeDatabase("GetFriendsListConnection");
+    result["success"] = true;
+    result["friends"] = usersToJson(Server::getInstance()->getFriendGraph().friends(userID));
     return result;
 }
 
-QJsonObject handleGetFriendsList(const QJsonObject &request, SOCKET clientSocket)
+QJsonObject handleGetFriendsList(const Request &request, SOCKET clientSocket)
 {
     int userID = request["userID"].toInt();
 
-    QJsonObject response = getFriendsList(userID, DB_NAME);
+    QJsonObject response = getFriendsList(userID);
     response["action"] = "getFriendsList";
     sendJsonResponse(clientSocket, response);
     qDebug() << "Sent get friends list response to client.";
@@ -495,59 +558,72 @@ QJsonObject handleGetFriendsList(const QJsonObject &request, SOCKET clientSocket
 QJsonObject unfriend(const int &userID1, const int &userID2, const std::string &dbName)
 {
     QJsonObject result;
-    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "UnfriendConnection");
-    db.setDatabaseName(QString::fromStdString(dbName));
-    if (!db.open()) {
-        qDebug() << "Failed to open database for unfriending:" << db.lastError().text();
+    PooledQuery query(dbName,
+                      "delete from Friendships "
+                      "where (UserID1 = :UserID1 and UserID2 = :UserID2) "
+                      "or (UserID1 = :UserID2 and UserID2 = :UserID1);");
+    if (!query.isValid()) {
         result["success"] = false;
         result["message"] = "Database connection error.";
         return result;
     }
 
-    QSqlQuery query(db);
-    query.prepare(
-        "delete from Friendships "
-        "where (UserID1 = :UserID1 and UserID2 = :UserID2) "
-        "or (UserID1 = :UserID2 and UserID2 = :UserID1);");
-    query.bindValue(":UserID1", userID1);
-    query.bindValue(":UserID2", userID2);
+    query->bindValue(":UserID1", userID1);
+    query->bindValue(":UserID2", userID2);
 
-    if (query.exec()) {
+    if (query->exec()) {
+        // Không có quan hệ nào bị xóa thì graph cũng giữ nguyên và không báo cho ai
+        bool changed = query->numRowsAffected() > 0;
+        if (changed) {
+            Server::getInstance()->getFriendGraph().removeFriendship(userID1, userID2);
+        }
         result["success"] = true;
-        result["message"] = "Unfriended successfully.";
+        result["changed"] = changed;
+        result["message"] = changed ? "Unfriended successfully." : "You are not friends with this user.";
     } else {
-        qDebug() << "Unfriending failed:" << query.lastError().text();
+        qDebug() << "Unfriending failed:" << query->lastError().text();
         result["success"] = false;
         result["message"] = "Failed to unfriend.";
     }
 
-    db.close();
-    QSqlDatabase::removeDatabase("UnfriendConnection");
     return result;
 }
 
-QJsonObject handleUnfriend(const QJsonObject &request, SOCKET clientSocket)
+QJsonObject handleUnfriend(const Request &request, SOCKET clientSocket)
 {
-    int userID1 = request["fromUserID"].toInt();
+    int userID1 = requireSessionUser(clientSocket, "unfriend");
+    if (userID1 == -1) {
+        return {};
+    }
     int userID2 = request["toUserID"].toInt();
 
     QJsonObject response = unfriend(userID1, userID2, DB_NAME);
     response["action"] = "unfriend";
-    // người dùng tải lại danh sách bạn bè là thấy kết quả
+    response["toUserID"] = userID2;
+    sendJsonResponse(clientSocket, response);
     qDebug() << "Sent unfriend response to client.";
+
+    if (response["changed"].toBool()) {
+        // Cũng dùng cho trường hợp hủy/từ chối lời mời đang chờ
+        QJsonObject event = {{"action", "unfriended"}, {"userID", userID1}};
+        Server::getInstance()->sendToUser(userID2, event);
+    }
     return response;
 }
 
-void initFriendHandlers(std::map<QString, std::function<QJsonObject(const QJsonObject &, SOCKET)>> &handlers)
+void initFriendHandlers(HandlerTable &handlers)
 {
-    handlers["sendMessage"] = handleSendMessage;
-    handlers["getAllMessages"] = handleGetAllMessages;
-    handlers["getAllUsers"] = handleGetAllUsers;
-    handlers["getNonFriendUsers"] = handleGetNonFriendUsers;
-    handlers["getFriendRequests"] = handleGetFriendRequests;
-    handlers["friendRequest"] = handleFriendRequest;
-    handlers["acceptFriendRequest"] = handleAcceptFriendRequest;
-    handlers["queryFriendStatus"] = handleQueryFriendStatus;
-    handlers["getFriendsList"] = handleGetFriendsList;
-    handlers["unfriend"] = handleUnfriend;
+    handlers.add(Opcode::SendMessage, handleSendMessage);
+    handlers.add(Opcode::GetAllMessages, handleGetAllMessages);
+    handlers.add(Opcode::GetMessageHistory, handleGetMessageHistory);
+    handlers.add(Opcode::SyncMessages, handleSyncMessages);
+    handlers.add(Opcode::GetAllUsers, handleGetAllUsers);
+    handlers.add(Opcode::GetNonFriendUsers, handleGetNonFriendUsers);
+    handlers.add(Opcode::SearchUsers, handleSearchUsers);
+    handlers.add(Opcode::GetFriendRequests, handleGetFriendRequests);
+    handlers.add(Opcode::FriendRequest, handleFriendRequest);
+    handlers.add(Opcode::AcceptFriendRequest, handleAcceptFriendRequest);
+    handlers.add(Opcode::QueryFriendStatus, handleQueryFriendStatus);
+    handlers.add(Opcode::GetFriendsList, handleGetFriendsList);
+    handlers.add(Opcode::Unfriend, handleUnfriend);
 }
@@ -5,10 +5,11 @@
 #include <functional>
 #include <QString>
 #include <QJsonObject>
-#include <winsock2.h>
+#include "handlertable.h"
+#include "platform.h"
 
-QJsonObject handleGetFriendRequests(const QJsonObject &request, SOCKET clientSocket);
+QJsonObject handleGetFriendRequests(const Request &request, SOCKET clientSocket);
 
-void initFriendHandlers(std::map<QString, std::function<QJsonObject(const QJsonObject &, SOCKET)>> &handlers);
+void initFriendHandlers(HandlerTable &handlers);
 
 #endif // FRIEND_H
@@ -0,0 +1,305 @@
+#include "friendgraph.h"
+#include "database.h"
+#include <QDebug>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <algorithm>
+#include <mutex>
+
+namespace {
+
+void insertSorted(std::vector<int> &ids, int id)
+{
+    auto it = std::lower_bound(ids.begin(), ids.end(), id);
+    if (it == ids.end() || *it != id) {
+        ids.insert(it, id);
+    }
+}
+
+void eraseSorted(std::vector<int> &ids, int id)
+{
+    auto it = std::lower_bound(ids.begin(), ids.end(), id);
+    if (it != ids.end() && *it == id) {
+        ids.erase(it);
+    }
+}
+
+bool containsSorted(const std::vector<int> &ids, int id)
+{
+    return std::binary_search(ids.begin(), ids.end(), id);
+}
+
+} // namespace
+
+bool FriendGraph::load(const std::string &dbName)
+{
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "FriendGraphConnection");
+    db.setDatabaseName(QString::fromStdString(dbName));
+    bool ok = db.open();
+    if (ok) {
+        configureConnection(db);
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        m_users.clear();
+        m_userIds.clear();
+        m_usernameIndex.clear();
+
+        QSqlQuery query(db);
+        query.setForwardOnly(true);
+        ok = query.exec("select UserID, Username from Users order by UserID;");
+        while (ok && query.next()) {
+            int userId = query.value(0).toInt();
+            m_users[userId].username = query.value(1).toString();
+            m_userIds.push_back(userId);
+            m_usernameIndex.emplace_back(m_users[userId].username.toCaseFolded(), userId);
+        }
+        std::sort(m_usernameIndex.begin(), m_usernameIndex.end());
+
+        // Nạp hết rồi sắp xếp một lần thay vì chèn có thứ tự từng cạnh
+        ok = ok && query.exec("select UserID1, UserID2, Status from Friendships;");
+        size_t edges = 0;
+        while (ok && query.next()) {
+            auto nodeA = m_users.find(query.value(0).toInt());
+            auto nodeB = m_users.find(query.value(1).toInt());
+            // Bỏ qua cạnh trỏ tới người dùng không còn trong Users
+            if (nodeA == m_users.end() || nodeB == m_users.end()) {
+                continue;
+            }
+            if (query.value(2).toInt() == 1) {
+                nodeA->second.friends.push_back(nodeB->first);
+                nodeB->second.friends.push_back(nodeA->first);
+            } else {
+                nodeA->second.outgoing.push_back(nodeB->first);
+                nodeB->second.incoming.push_back(nodeA->first);
+            }
+            ++edges;
+        }
+        for (auto &entry : m_users) {
+            for (std::vector<int> *ids : {&entry.second.friends, &entry.second.incoming, &entry.second.outgoing}) {
+                std::sort(ids->begin(), ids->end());
+                ids->erase(std::unique(ids->begin(), ids->end()), ids->end());
+            }
+        }
+        if (!ok) {
+            qDebug() << "Loading friendship graph failed:" << query.lastError().text();
+        } else {
+            qDebug() << "Friendship graph loaded:" << m_userIds.size() << "users," << edges << "friendships.";
+        }
+        query.finish();
+        db.close();
+    } else {
+        qDebug() << "Failed to open database for friendship graph:" << db.lastError().text();
+    }
+    db = QSqlDatabase();
+    QSqlDatabase::removeDatabase("FriendGraphConnection");
+    return ok;
+}
+
+void FriendGraph::addUser(int userId, const QString &username)
+{
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    m_users[userId].username = username;
+    insertSorted(m_userIds, userId);
+    std::pair<QString, int> key(username.toCaseFolded(), userId);
+    auto it = std::lower_bound(m_usernameIndex.begin(), m_usernameIndex.end(), key);
+    if (it == m_usernameIndex.end() || *it != key) {
+        m_usernameIndex.insert(it, key);
+    }
+}
+
+bool FriendGraph::hasUser(int userId) const
+{
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    return m_users.find(userId) != m_users.end();
+}
+
+void FriendGraph::addRequest(int fromUserId, int toUserId)
+{
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    auto from = m_users.find(fromUserId);
+    auto to = m_users.find(toUserId);
+    if (from == m_users.end() || to == m_users.end()) {
+        return;
+    }
+    insertSorted(from->second.outgoing, toUserId);
+    insertSorted(to->second.incoming, fromUserId);
+}
+
+void FriendGraph::acceptRequest(int userA, int userB)
+{
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    auto itA = m_users.find(userA);
+    auto itB = m_users.find(userB);
+    if (itA == m_users.end() || itB == m_users.end()) {
+        return;
+    }
+    UserNode &nodeA = itA->second;
+    UserNode &nodeB = itB->second;
+    // Giống câu update trong acceptFriendRequest: lời mời theo chiều nào cũng được chấp nhận
+    eraseSorted(nodeA.outgoing, userB);
+    eraseSorted(nodeA.incoming, userB);
+    eraseSorted(nodeB.outgoing, userA);
+    eraseSorted(nodeB.incoming, userA);
+    insertSorted(nodeA.friends, userB);
+    insertSorted(nodeB.friends, userA);
+}
+
+void FriendGraph::removeFriendship(int userA, int userB)
+{
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    auto itA = m_users.find(userA);
+    auto itB = m_users.find(userB);
+    if (itA == m_users.end() || itB == m_users.end()) {
+        return;
+    }
+    UserNode &nodeA = itA->second;
+    UserNode &nodeB = itB->second;
+    eraseSorted(nodeA.friends, userB);
+    eraseSorted(nodeA.outgoing, userB);
+    eraseSorted(nodeA.incoming, userB);
+    eraseSorted(nodeB.friends, userA);
+    eraseSorted(nodeB.outgoing, userA);
+    eraseSorted(nodeB.incoming, userA);
+}
+
+QString FriendGraph::username(int userId) const
+{
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    auto it = m_users.find(userId);
+    if (it == m_users.end()) {
+        return QString();
+    }
+    return it->second.username;
+}
+
+std::vector<int> FriendGraph::friendsOf(int userId) const
+{
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    auto it = m_users.find(userId);
+    if (it == m_users.end()) {
+        return {};
+    }
+    return it->second.friends;
+}
+
+FriendStatus FriendGraph::status(int fromUserId, int toUserId) const
+{
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    auto it = m_users.find(fromUserId);
+    if (it == m_users.end()) {
+        return FriendStatus::None;
+    }
+    const UserNode &node = it->second;
+    if (containsSorted(node.friends, toUserId)) {
+        return FriendStatus::Friends;
+    }
+    if (containsSorted(node.outgoing, toUserId)) {
+        return FriendStatus::RequestSent;
+    }
+    if (containsSorted(node.incoming, toUserId)) {
+        return FriendStatus::RequestReceived;
+    }
+    return FriendStatus::None;
+}
+
+std::vector<UserEntry> FriendGraph::allUsers() const
+{
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    return entriesLocked(m_userIds);
+}
+
+std::vector<UserEntry> FriendGraph::friends(int userId) const
+{
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    auto it = m_users.find(userId);
+    if (it == m_users.end()) {
+        return {};
+    }
+    return entriesLocked(it->second.friends);
+}
+
+std::vector<UserEntry> FriendGraph::incomingRequests(int userId) const
+{
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    auto it = m_users.find(userId);
+    if (it == m_users.end()) {
+        return {};
+    }
+    return entriesLocked(it->second.incoming);
+}
+
+std::vector<UserEntry> FriendGraph::nonFriends(int userId) const
+{
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    static const std::vector<int> noFriends;
+    auto it = m_users.find(userId);
+    const std::vector<int> &friendIds = it != m_users.end() ? it->second.friends : noFriends;
+
+    // Cả hai danh sách đều đã sắp xếp nên trừ tập hợp trong một lượt duyệt
+    std::vector<UserEntry> result;
+    result.reserve(m_userIds.size() - std::min(m_userIds.size(), friendIds.size()));
+    auto friendIt = friendIds.begin();
+    for (int id : m_userIds) {
+        while (friendIt != friendIds.end() && *friendIt < id) {
+            ++friendIt;
+        }
+        if (id == userId || (friendIt != friendIds.end() && *friendIt == id)) {
+            continue;
+        }
+        result.push_back({id, m_users.at(id).username});
+    }
+    return result;
+}
+
+std::vector<UserEntry> FriendGraph::searchUsers(int userId,
+                                                const QString &prefix,
+                                                int afterUserId,
+                                                int limit,
+                                                bool nonFriendsOnly,
+                                                bool &hasMore) const
+{
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    hasMore = false;
+    QString foldedPrefix = prefix.toCaseFolded();
+
+    // Bắt đầu ngay sau cursor nếu có, nếu không thì từ username nhỏ nhất mang tiền tố
+    auto it = std::lower_bound(m_usernameIndex.begin(),
+                               m_usernameIndex.end(),
+                               std::pair<QString, int>(foldedPrefix, 0));
+    auto cursor = m_users.find(afterUserId);
+    if (afterUserId > 0 && cursor != m_users.end()) {
+        std::pair<QString, int> last(cursor->second.username.toCaseFolded(), afterUserId);
+        it = std::max(it, std::upper_bound(m_usernameIndex.begin(), m_usernameIndex.end(), last));
+    }
+
+    static const std::vector<int> noFriends;
+    auto self = m_users.find(userId);
+    const std::vector<int> &friendIds = self != m_users.end() ? self->second.friends : noFriends;
+
+    std::vector<UserEntry> result;
+    for (; it != m_usernameIndex.end() && it->first.startsWith(foldedPrefix); ++it) {
+        int id = it->second;
+        if (nonFriendsOnly && (id == userId || containsSorted(friendIds, id))) {
+            continue;
+        }
+        if (static_cast<int>(result.size()) >= limit) {
+            hasMore = true;
+            break;
+        }
+        result.push_back({id, m_users.at(id).username});
+    }
+    return result;
+}
+
+std::vector<UserEntry> FriendGraph::entriesLocked(const std::vector<int> &userIds) const
+{
+    std::vector<UserEntry> result;
+    result.reserve(userIds.size());
+    for (int id : userIds) {
+        auto it = m_users.find(id);
+        if (it != m_users.end()) {
+            result.push_back({id, it->second.username});
+        }
+    }
+    return result;
+}
@@ -0,0 +1,88 @@
+#ifndef FRIENDGRAPH_H
+#define FRIENDGRAPH_H
+
+#include <QString>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Quan hệ giữa hai người dùng, nhìn từ phía người hỏi; giá trị trùng với
+// trường "status" của queryFriendStatus
+enum class FriendStatus {
+    None = -1,
+    RequestSent = 0,
+    Friends = 1,
+    RequestReceived = 2,
+};
+
+struct UserEntry
+{
+    int userId;
+    QString username;
+};
+
+// Bản sao trong bộ nhớ của Users (UserID, Username) và Friendships.
+// Nạp toàn bộ khi server khởi động, sau đó được cập nhật kiểu write-through:
+// handler ghi database trước, thành công rồi mới gọi addUser/addRequest/
+// acceptRequest/removeFriendship. Các endpoint đọc không chạm tới SQLite.
+// Danh sách bạn bè và lời mời của mỗi người dùng là vector UserID đã sắp xếp.
+class FriendGraph
+{
+public:
+    FriendGraph() = default;
+
+    FriendGraph(const FriendGraph &) = delete;
+    FriendGraph &operator=(const FriendGraph &) = delete;
+
+    bool load(const std::string &dbName);
+
+    void addUser(int userId, const QString &username);
+    // Các hàm ghi bỏ qua UserID không có trong graph, không tạo nút mới
+    void addRequest(int fromUserId, int toUserId);
+    void acceptRequest(int userA, int userB);
+    void removeFriendship(int userA, int userB);
+
+    bool hasUser(int userId) const;
+    // Chuỗi rỗng nếu không có người dùng này
+    QString username(int userId) const;
+    // UserID của bạn bè, tăng dần
+    std::vector<int> friendsOf(int userId) const;
+    FriendStatus status(int fromUserId, int toUserId) const;
+
+    std::vector<UserEntry> allUsers() const;
+    std::vector<UserEntry> friends(int userId) const;
+    // Những người đã gửi lời mời kết bạn cho userId
+    std::vector<UserEntry> incomingRequests(int userId) const;
+    // Mọi người dùng khác userId chưa là bạn (kể cả đang chờ lời mời)
+    std::vector<UserEntry> nonFriends(int userId) const;
+    // Tìm theo tiền tố username (không phân biệt hoa thường), theo thứ tự username.
+    // afterUserId là người cuối cùng của trang trước (0 = từ đầu); nonFriendsOnly bỏ
+    // qua userId và bạn bè của userId ngay trong lúc duyệt chỉ mục.
+    std::vector<UserEntry> searchUsers(int userId,
+                                       const QString &prefix,
+                                       int afterUserId,
+                                       int limit,
+                                       bool nonFriendsOnly,
+                                       bool &hasMore) const;
+
+private:
+    struct UserNode
+    {
+        QString username;
+        std::vector<int> friends;
+        std::vector<int> incoming;
+        std::vector<int> outgoing;
+    };
+
+    std::vector<UserEntry> entriesLocked(const std::vector<int> &userIds) const;
+
+    mutable std::shared_mutex m_mutex;
+    std::unordered_map<int, UserNode> m_users;
+    // Mọi UserID theo thứ tự tăng dần, để liệt kê người dùng theo thứ tự ổn định
+    std::vector<int> m_userIds;
+    // (username đã case-fold, UserID) sắp xếp tăng dần: tìm tiền tố bằng lower_bound
+    std::vector<std::pair<QString, int>> m_usernameIndex;
+};
+
+#endif // FRIENDGRAPH_H
@@ -0,0 +1,390 @@
+#include <QDebug>
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QSqlError>
+#include <QString>
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include "config.h"
+#include "database.h"
+#include "groupcache.h"
+#include "server.h"
+#include "group.h"
+#include "header.h"
+
+#define DEFAULT_GROUP_PAGE_SIZE 50
+#define MAX_GROUP_PAGE_SIZE 200
+
+// Gửi cùng một payload đã serialize tới mọi thành viên online của nhóm (trừ exceptUserID).
+// QByteArray dùng chung buffer nên mỗi người nhận chỉ tốn thêm một tham chiếu.
+static int fanOutToGroup(int groupID, const QJsonObject &event, int exceptUserID)
+{
+    GroupCache::MemberList members = Server::getInstance()->getGroupCache().members(groupID);
+    if (!members) {
+        return 0;
+    }
+    EncodedMessage payload(event);
+    int delivered = 0;
+    for (int memberID : *members) {
+        if (memberID != exceptUserID) {
+            delivered += Server::getInstance()->sendToUser(memberID, payload);
+        }
+    }
+    return delivered;
+}
+
+QJsonObject createGroup(int userID, const QString &groupName, const std::string &dbName)
+{
+    QJsonObject result;
+    QSqlDatabase &db = threadDatabase(dbName);
+    if (!db.isOpen() || !db.transaction()) {
+        result["success"] = false;
+        result["message"] = "Database connection error.";
+        return result;
+    }
+
+    // Nhóm và người tạo (thành viên đầu tiên) được ghi trong cùng một transaction
+    int groupID = -1;
+    bool ok = false;
+    {
+        PooledQuery insertGroup(dbName, "insert into Groups (GroupName) values (:GroupName);");
+        PooledQuery insertMember(dbName, "insert into GroupMembers (GroupID, UserID) values (:GroupID, :UserID);");
+        if (insertGroup.isValid() && insertMember.isValid()) {
+            insertGroup->bindValue(":GroupName", groupName);
+            if (insertGroup->exec()) {
+                groupID = insertGroup->lastInsertId().toInt();
+                insertMember->bindValue(":GroupID", groupID);
+                insertMember->bindValue(":UserID", userID);
+                ok = insertMember->exec();
+                if (!ok) {
+                    qDebug() << "Adding group creator failed:" << insertMember->lastError().text();
+                }
+            } else {
+                qDebug() << "Creating group failed:" << insertGroup->lastError().text();
+            }
+        }
+    }
+
+    if (!ok || !db.commit()) {
+        db.rollback();
+        result["success"] = false;
+        result["message"] = "Failed to create group.";
+        return result;
+    }
+
+    Server::getInstance()->getGroupCache().addGroup(groupID, groupName, userID);
+    result["success"] = true;
+    result["message"] = "Group created successfully.";
+    result["groupID"] = groupID;
+    result["groupName"] = groupName;
+    return result;
+}
+
+QJsonObject handleCreateGroup(const Request &request, SOCKET clientSocket)
+{
+    // Người thực hiện luôn là người đã đăng nhập trên kết nối, không lấy từ request
+    int userID = requireSessionUser(clientSocket, "createGroup");
+    if (userID == -1) {
+        return {};
+    }
+    QString groupName = request["groupName"].toString();
+
+    QJsonObject response;
+    if (groupName.isEmpty()) {
+        response = {{"success", false}, {"message", "Group name is required."}};
+    } else {
+        response = createGroup(userID, groupName, DB_NAME);
+    }
+    response["action"] = "createGroup";
+    sendJsonResponse(clientSocket, response);
+    qDebug() << "Sent create group response to client.";
+    return response;
+}
+
+QJsonObject joinGroup(int userID, int groupID, const std::string &dbName)
+{
+    QJsonObject result;
+    GroupCache &groups = Server::getInstance()->getGroupCache();
+    if (!groups.exists(groupID)) {
+        result["success"] = false;
+        result["message"] = "Group not found.";
+        return result;
+    }
+
+    PooledQuery query(dbName, "insert or ignore into GroupMembers (GroupID, UserID) values (:GroupID, :UserID);");
+    if (!query.isValid()) {
+        result["success"] = false;
+        result["message"] = "Database connection error.";
+        return result;
+    }
+
+    query->bindValue(":GroupID", groupID);
+    query->bindValue(":UserID", userID);
+
+    if (query->exec()) {
+        groups.addMember(groupID, userID);
+        result["success"] = true;
+        result["message"] = "Joined group successfully.";
+        result["groupID"] = groupID;
+        result["groupName"] = groups.groupName(groupID);
+    } else {
+        qDebug() << "Joining group failed:" << query->lastError().text();
+        result["success"] = false;
+        result["message"] = "Failed to join group.";
+    }
+
+    return result;
+}
+
+QJsonObject handleJoinGroup(const Request &request, SOCKET clientSocket)
+{
+    int userID = requireSessionUser(clientSocket, "joinGroup");
+    if (userID == -1) {
+        return {};
+    }
+    int groupID = request["groupID"].toInt();
+
+    QJsonObject response = joinGroup(userID, groupID, DB_NAME);
+    response["action"] = "joinGroup";
+    sendJsonResponse(clientSocket, response);
+    qDebug() << "Sent join group response to client.";
+
+    if (response["success"].toBool()) {
+        QJsonObject event = {{"action", "groupMemberJoined"}, {"groupID", groupID}, {"userID", userID}};
+        fanOutToGroup(groupID, event, userID);
+    }
+    return response;
+}
+
+QJsonObject leaveGroup(int userID, int groupID, const std::string &dbName)
+{
+    QJsonObject result;
+    PooledQuery query(dbName, "delete from GroupMembers where GroupID = :GroupID and UserID = :UserID;");
+    if (!query.isValid()) {
+        result["success"] = false;
+        result["message"] = "Database connection error.";
+        return result;
+    }
+
+    query->bindValue(":GroupID", groupID);
+    query->bindValue(":UserID", userID);
+
+    if (query->exec()) {
+        Server::getInstance()->getGroupCache().removeMember(groupID, userID);
+        result["success"] = true;
+        result["message"] = "Left group successfully.";
+        result["groupID"] = groupID;
+    } else {
+        qDebug() << "Leaving group failed:" << query->lastError().text();
+        result["success"] = false;
+        result["message"] = "Failed to leave group.";
+    }
+
+    return result;
+}
+
+QJsonObject handleLeaveGroup(const Request &request, SOCKET clientSocket)
+{
+    int userID = requireSessionUser(clientSocket, "leaveGroup");
+    if (userID == -1) {
+        return {};
+    }
+    int groupID = request["groupID"].toInt();
+
+    QJsonObject response = leaveGroup(userID, groupID, DB_NAME);
+    response["action"] = "leaveGroup";
+    sendJsonResponse(clientSocket, response);
+    qDebug() << "Sent leave group response to client.";
+
+    if (response["success"].toBool()) {
+        QJsonObject event = {{"action", "groupMemberLeft"}, {"groupID", groupID}, {"userID", userID}};
+        fanOutToGroup(groupID, event, userID);
+    }
+    return response;
+}
+
+QJsonObject getGroups(int userID)
+{
+    QJsonArray groupsArray;
+    for (const auto &group : Server::getInstance()->getGroupCache().groupsOf(userID)) {
+        QJsonObject groupObj;
+        groupObj["groupID"] = group.first;
+        groupObj["groupName"] = group.second;
+        groupsArray.append(groupObj);
+    }
+    QJsonObject result;
+    result["success"] = true;
+    result["groups"] = groupsArray;
+    return result;
+}
+
+QJsonObject handleGetGroups(const Request &request, SOCKET clientSocket)
+{
+    int userID = requireSessionUser(clientSocket, "getGroups");
+    if (userID == -1) {
+        return {};
+    }
+
+    QJsonObject response = getGroups(userID);
+    response["action"] = "getGroups";
+    sendJsonResponse(clientSocket, response);
+    qDebug() << "Sent get groups response to client.";
+    return response;
+}
+
+QJsonObject handleSendGroupMessage(const Request &request, SOCKET clientSocket)
+{
+    int senderID = requireSessionUser(clientSocket, "sendGroupMessage");
+    if (senderID == -1) {
+        return {};
+    }
+    int groupID = request["groupID"].toInt();
+    QString content = request["content"].toString();
+    QString sentAt = QDateTime::currentDateTimeUtc().toString("yyyy-MM-dd HH:mm:ss");
+
+    QJsonObject response = {{"action", "sendGroupMessage"}, {"groupID", groupID}, {"sentAt", sentAt}};
+    if (request.contains("clientMessageId")) {
+        response["clientMessageId"] = request["clientMessageId"].toJsonValue();
+    }
+    if (!request["content"].isString()) {
+        response["success"] = false;
+        response["message"] = "Message content must be a string.";
+        sendJsonResponse(clientSocket, response);
+        return response;
+    }
+
+    if (!Server::getInstance()->getGroupCache().isMember(groupID, senderID)) {
+        response["success"] = false;
+        response["message"] = "You are not a member of this group.";
+        sendJsonResponse(clientSocket, response);
+        return response;
+    }
+
+    // Một dòng GroupMessages bất kể nhóm có bao nhiêu thành viên, ghi theo lô cùng tin
+    // nhắn riêng trên MessageWriter; tin được cấp ID và giao cho thành viên ngay
+    MessageWriter &writer = Server::getInstance()->getMessageWriter();
+    MessageWriter::CommitCallback onCommitted;
+    if (serverConfig().ackAfterCommit) {
+        ConnectionPtr sender = Server::getInstance()->findConnection(clientSocket);
+        onCommitted = [sender, response](qint64 messageId, bool ok) mutable {
+            response["success"] = ok;
+            response["message"] = ok ? "Group message sent." : "Failed to send group message.";
+            response["messageId"] = messageId;
+            response["durable"] = ok;
+            if (sender) {
+                sendJsonResponse(sender, response);
+            }
+        };
+    }
+    qint64 messageId = writer.enqueueGroup(groupID, senderID, content, sentAt, std::move(onCommitted));
+
+    if (!serverConfig().ackAfterCommit) {
+        response["success"] = true;
+        response["message"] = "Group message queued.";
+        response["messageId"] = messageId;
+        response["durable"] = false;
+        sendJsonResponse(clientSocket, response);
+    }
+
+    QJsonObject event = {{"action", "receiveGroupMessage"},
+                         {"groupID", groupID},
+                         {"messageId", messageId},
+                         {"senderID", senderID},
+                         {"content", content},
+                         {"sentAt", sentAt}};
+    int delivered = fanOutToGroup(groupID, event, senderID);
+    qDebug() << "Group message" << messageId << "to group" << groupID << "delivered to" << delivered << "sessions.";
+    return response;
+}
+
+// Lịch sử nhóm phân trang theo GroupMessageID (keyset), trang mới nhất khi beforeMessageId = 0
+QJsonObject getGroupMessages(int groupID, qint64 beforeMessageId, int pageSize, const std::string &dbName)
+{
+    QJsonObject result;
+    PooledQuery query(dbName,
+                      "select GroupMessageID, SenderID, Content, SentAt from GroupMessages "
+                      "where GroupID = :GroupID and GroupMessageID < :Cursor "
+                      "order by GroupMessageID desc LIMIT :Limit;");
+    if (!query.isValid()) {
+        result["success"] = false;
+        result["message"] = "Database connection error.";
+        return result;
+    }
+
+    query->bindValue(":GroupID", groupID);
+    query->bindValue(":Cursor", beforeMessageId > 0 ? beforeMessageId : std::numeric_limits<qint64>::max());
+    query->bindValue(":Limit", pageSize + 1);
+
+    if (!query->exec()) {
+        qDebug() << "Returning group messages failed:" << query->lastError().text();
+        result["success"] = false;
+        result["message"] = "Failed to retrieve group messages.";
+        return result;
+    }
+
+    std::vector<QJsonObject> rows;
+    while (query->next()) {
+        QJsonObject messageObj;
+        messageObj["messageId"] = query->value(0).toLongLong();
+        messageObj["senderID"] = query->value(1).toInt();
+        messageObj["content"] = query->value(2).toString();
+        messageObj["sentAt"] = query->value(3).toString();
+        rows.push_back(messageObj);
+    }
+    bool hasMore = rows.size() > static_cast<size_t>(pageSize);
+    if (hasMore) {
+        rows.pop_back();
+    }
+
+    // Trả về theo thứ tự thời gian
+    QJsonArray messagesArray;
+    for (auto it = rows.rbegin(); it != rows.rend(); ++it) {
+        messagesArray.append(*it);
+    }
+    result["success"] = true;
+    result["messages"] = messagesArray;
+    result["hasMore"] = hasMore;
+    if (!rows.empty()) {
+        result["oldestMessageId"] = rows.back()["messageId"];
+    }
+    return result;
+}
+
+QJsonObject handleGetGroupMessages(const Request &request, SOCKET clientSocket)
+{
+    int userID = requireSessionUser(clientSocket, "getGroupMessages");
+    if (userID == -1) {
+        return {};
+    }
+    int groupID = request["groupID"].toInt();
+    qint64 beforeMessageId = request["beforeMessageId"].toLongLong();
+    int pageSize = request["pageSize"].toInt(DEFAULT_GROUP_PAGE_SIZE);
+    pageSize = std::min(std::max(pageSize, 1), MAX_GROUP_PAGE_SIZE);
+
+    QJsonObject response;
+    if (Server::getInstance()->getGroupCache().isMember(groupID, userID)) {
+        // Tin vừa gửi có thể còn trong hàng đợi ghi
+        MessageWriter &writer = Server::getInstance()->getMessageWriter();
+        writer.waitForGroupCommit(writer.lastAllocatedGroupId());
+        response = getGroupMessages(groupID, beforeMessageId, pageSize, DB_NAME);
+    } else {
+        response = {{"success", false}, {"message", "You are not a member of this group."}};
+    }
+    response["action"] = "getGroupMessages";
+    response["groupID"] = groupID;
+    sendJsonResponse(clientSocket, response);
+    qDebug() << "Sent group messages response to client.";
+    return response;
+}
+
+void initGroupHandlers(HandlerTable &handlers)
+{
+    handlers.add(Opcode::CreateGroup, handleCreateGroup);
+    handlers.add(Opcode::JoinGroup, handleJoinGroup);
+    handlers.add(Opcode::LeaveGroup, handleLeaveGroup);
+    handlers.add(Opcode::GetGroups, handleGetGroups);
+    handlers.add(Opcode::SendGroupMessage, handleSendGroupMessage);
+    handlers.add(Opcode::GetGroupMessages, handleGetGroupMessages);
+}
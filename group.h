@@ -0,0 +1,13 @@
+#ifndef GROUP_H
+#define GROUP_H
+
+#include <map>
+#include <functional>
+#include <QString>
+#include <QJsonObject>
+#include "handlertable.h"
+#include "platform.h"
+
+void initGroupHandlers(HandlerTable &handlers);
+
+#endif // GROUP_H
@@ -0,0 +1,156 @@
+#include "groupcache.h"
+#include "database.h"
+#include <QDebug>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <algorithm>
+#include <mutex>
+
+bool GroupCache::load(const std::string &dbName)
+{
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "GroupCacheConnection");
+    db.setDatabaseName(QString::fromStdString(dbName));
+    bool ok = db.open();
+    if (ok) {
+        configureConnection(db);
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        m_groups.clear();
+        m_userGroups.clear();
+
+        QSqlQuery query(db);
+        query.setForwardOnly(true);
+        ok = query.exec("select GroupID, GroupName from Groups;");
+        while (ok && query.next()) {
+            m_groups[query.value(0).toInt()].name = query.value(1).toString();
+        }
+
+        std::unordered_map<int, std::vector<int>> members;
+        ok = ok && query.exec("select GroupID, UserID from GroupMembers order by GroupID, UserID;");
+        size_t memberships = 0;
+        while (ok && query.next()) {
+            int groupId = query.value(0).toInt();
+            int userId = query.value(1).toInt();
+            members[groupId].push_back(userId);
+            m_userGroups[userId].push_back(groupId);
+            ++memberships;
+        }
+        for (auto &entry : members) {
+            m_groups[entry.first].members = std::make_shared<const std::vector<int>>(std::move(entry.second));
+        }
+        for (auto &entry : m_userGroups) {
+            std::sort(entry.second.begin(), entry.second.end());
+        }
+
+        if (!ok) {
+            qDebug() << "Loading groups failed:" << query.lastError().text();
+        } else {
+            qDebug() << "Groups loaded:" << m_groups.size() << "groups," << memberships << "memberships.";
+        }
+        query.finish();
+        db.close();
+    } else {
+        qDebug() << "Failed to open database for groups:" << db.lastError().text();
+    }
+    db = QSqlDatabase();
+    QSqlDatabase::removeDatabase("GroupCacheConnection");
+    return ok;
+}
+
+void GroupCache::addGroup(int groupId, const QString &groupName, int creatorId)
+{
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    GroupInfo &group = m_groups[groupId];
+    group.name = groupName;
+    group.members = std::make_shared<const std::vector<int>>(1, creatorId);
+    std::vector<int> &groups = m_userGroups[creatorId];
+    groups.insert(std::lower_bound(groups.begin(), groups.end(), groupId), groupId);
+}
+
+void GroupCache::addMember(int groupId, int userId)
+{
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    GroupInfo &group = m_groups[groupId];
+    std::vector<int> members = group.members ? *group.members : std::vector<int>();
+    auto it = std::lower_bound(members.begin(), members.end(), userId);
+    if (it != members.end() && *it == userId) {
+        return;
+    }
+    members.insert(it, userId);
+    group.members = std::make_shared<const std::vector<int>>(std::move(members));
+
+    std::vector<int> &groups = m_userGroups[userId];
+    groups.insert(std::lower_bound(groups.begin(), groups.end(), groupId), groupId);
+}
+
+void GroupCache::removeMember(int groupId, int userId)
+{
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    auto groupIt = m_groups.find(groupId);
+    if (groupIt != m_groups.end() && groupIt->second.members) {
+        std::vector<int> members = *groupIt->second.members;
+        members.erase(std::remove(members.begin(), members.end(), userId), members.end());
+        groupIt->second.members = std::make_shared<const std::vector<int>>(std::move(members));
+    }
+
+    auto userIt = m_userGroups.find(userId);
+    if (userIt != m_userGroups.end()) {
+        std::vector<int> &groups = userIt->second;
+        groups.erase(std::remove(groups.begin(), groups.end(), groupId), groups.end());
+    }
+}
+
+bool GroupCache::exists(int groupId) const
+{
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    return m_groups.find(groupId) != m_groups.end();
+}
+
+bool GroupCache::isMember(int groupId, int userId) const
+{
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    auto it = m_groups.find(groupId);
+    if (it == m_groups.end() || !it->second.members) {
+        return false;
+    }
+    const std::vector<int> &members = *it->second.members;
+    return std::binary_search(members.begin(), members.end(), userId);
+}
+
+QString GroupCache::groupName(int groupId) const
+{
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    auto it = m_groups.find(groupId);
+    if (it == m_groups.end()) {
+        return QString();
+    }
+    return it->second.name;
+}
+
+GroupCache::MemberList GroupCache::members(int groupId) const
+{
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    auto it = m_groups.find(groupId);
+    if (it == m_groups.end()) {
+        return nullptr;
+    }
+    return it->second.members;
+}
+
+std::vector<std::pair<int, QString>> GroupCache::groupsOf(int userId) const
+{
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    std::vector<std::pair<int, QString>> result;
+    auto it = m_userGroups.find(userId);
+    if (it == m_userGroups.end()) {
+        return result;
+    }
+    result.reserve(it->second.size());
+    for (int groupId : it->second) {
+        auto groupIt = m_groups.find(groupId);
+        if (groupIt != m_groups.end()) {
+            result.emplace_back(groupId, groupIt->second.name);
+        }
+    }
+    return result;
+}
@@ -0,0 +1,52 @@
+#ifndef GROUPCACHE_H
+#define GROUPCACHE_H
+
+#include <QString>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Danh sách nhóm và thành viên (Groups, GroupMembers) giữ trong bộ nhớ.
+// Nạp khi server khởi động, cập nhật write-through sau khi handler ghi database.
+// Danh sách thành viên là snapshot bất biến dùng chung: fan-out chỉ cần lấy một
+// shared_ptr thay vì sao chép hàng nghìn UserID, còn join/leave thay bằng bản mới.
+class GroupCache
+{
+public:
+    typedef std::shared_ptr<const std::vector<int>> MemberList;
+
+    GroupCache() = default;
+
+    GroupCache(const GroupCache &) = delete;
+    GroupCache &operator=(const GroupCache &) = delete;
+
+    bool load(const std::string &dbName);
+
+    void addGroup(int groupId, const QString &groupName, int creatorId);
+    void addMember(int groupId, int userId);
+    void removeMember(int groupId, int userId);
+
+    bool exists(int groupId) const;
+    bool isMember(int groupId, int userId) const;
+    QString groupName(int groupId) const;
+    // UserID của thành viên, tăng dần; nullptr nếu không có nhóm này
+    MemberList members(int groupId) const;
+    // (GroupID, GroupName) các nhóm userId đang tham gia
+    std::vector<std::pair<int, QString>> groupsOf(int userId) const;
+
+private:
+    struct GroupInfo
+    {
+        QString name;
+        MemberList members;
+    };
+
+    mutable std::shared_mutex m_mutex;
+    std::unordered_map<int, GroupInfo> m_groups;
+    std::unordered_map<int, std::vector<int>> m_userGroups;
+};
+
+#endif // GROUPCACHE_H
@@ -0,0 +1,25 @@
+#ifndef HANDLERTABLE_H
+#define HANDLERTABLE_H
+
+#include "codec.h"
+#include "opcode.h"
+#include "platform.h"
+#include <QJsonObject>
+#include <cstddef>
+
+typedef QJsonObject (*RequestHandler)(const Request &request, SOCKET clientSocket);
+
+// Bảng handler đánh chỉ mục theo opcode: dispatch chỉ là một lần truy cập mảng,
+// không so sánh chuỗi và không cấp phát. Chỉ được ghi khi server khởi động.
+class HandlerTable
+{
+public:
+    void add(Opcode opcode, RequestHandler handler) { m_handlers[static_cast<size_t>(opcode)] = handler; }
+    // nullptr nếu opcode chưa có handler
+    RequestHandler find(Opcode opcode) const { return m_handlers[static_cast<size_t>(opcode)]; }
+
+private:
+    RequestHandler m_handlers[static_cast<size_t>(Opcode::Count)] = {};
+};
+
+#endif // HANDLERTABLE_H
@@ -1,12 +1,17 @@
 #ifndef HEADER_H
 #define HEADER_H
 
-#include <winsock2.h>
+#include "connection.h"
+#include "logger.h"
+#include "platform.h"
 #include <QJsonObject>
 #include <string>
 
 int sendJsonResponse(SOCKET clientSocket, const QJsonObject &response);
-void initLog();
-void logMessage(const std::string &message);
+int sendJsonResponse(const ConnectionPtr &conn, const QJsonObject &response);
+
+// UserID của phiên đăng nhập trên kết nối. Chưa đăng nhập thì gửi phản hồi lỗi
+// {action, success: false} và trả về -1; handler dừng lại, không tin userID trong request.
+int requireSessionUser(SOCKET clientSocket, const char *action);
 
 #endif // HEADER_H
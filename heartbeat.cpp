@@ -0,0 +1,129 @@
+#include "heartbeat.h"
+#include "header.h"
+#include "server.h"
+#include <QDebug>
+
+// "ping" dựng sẵn cho hai kiểu mã hóa, dùng chung cho mọi kết nối
+static const QByteArray &pingFrame(WireEncoding encoding)
+{
+    static const QByteArray json = encodeMessage({{"action", "ping"}}, WireEncoding::Json);
+    static const QByteArray cbor = encodeMessage({{"action", "ping"}}, WireEncoding::Cbor);
+    return encoding == WireEncoding::Cbor ? cbor : json;
+}
+
+HeartbeatMonitor::HeartbeatMonitor(int pingIntervalMs, int idleTimeoutMs, int tickMs)
+    : m_pingIntervalMs(pingIntervalMs)
+    , m_idleTimeoutMs(idleTimeoutMs)
+    , m_tickMs(tickMs)
+    , m_startMs(monotonicMs())
+{
+    m_thread = std::thread(&HeartbeatMonitor::run, this);
+}
+
+HeartbeatMonitor::~HeartbeatMonitor()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_cond.notify_one();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+uint64_t HeartbeatMonitor::tickAt(int64_t ms) const
+{
+    // Làm tròn lên để timer không bao giờ chạy sớm hơn mốc
+    return static_cast<uint64_t>((ms - m_startMs + m_tickMs - 1) / m_tickMs);
+}
+
+void HeartbeatMonitor::watch(const ConnectionPtr &conn)
+{
+    int64_t now = monotonicMs();
+    conn->lastActivityMs.store(now, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_wheel.schedule(tickAt(now + m_pingIntervalMs), conn);
+}
+
+int64_t HeartbeatMonitor::check(const ConnectionPtr &conn, int64_t nowMs)
+{
+    if (conn->closing.load()) {
+        return -1;
+    }
+    int64_t last = conn->lastActivityMs.load(std::memory_order_relaxed);
+    int64_t idle = nowMs - last;
+    if (idle >= m_idleTimeoutMs) {
+        // Reactor dọn dẹp (gỡ phiên, báo offline) khi nhận sự kiện hangup như ngắt kết nối thường
+        qDebug() << "Closing idle connection from" << QString::fromStdString(conn->peerIp) << "after" << idle
+                 << "ms";
+        m_reaped.fetch_add(1, std::memory_order_relaxed);
+        conn->close();
+        return -1;
+    }
+    if (idle >= m_pingIntervalMs) {
+        // Client trả lời bất kỳ frame nào (thường là "pong") đều làm mới mốc
+        conn->sendFrame(pingFrame(WireEncoding::Json), pingFrame(WireEncoding::Cbor));
+        return last + m_idleTimeoutMs;
+    }
+    return last + m_pingIntervalMs;
+}
+
+void HeartbeatMonitor::run()
+{
+    std::vector<WatchedConnection> expired;
+    std::vector<std::pair<int64_t, ConnectionPtr>> rescheduled;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_stopping) {
+        m_cond.wait_for(lock, std::chrono::milliseconds(m_tickMs), [this] { return m_stopping; });
+        if (m_stopping) {
+            break;
+        }
+        int64_t now = monotonicMs();
+        m_wheel.advance(static_cast<uint64_t>((now - m_startMs) / m_tickMs), expired);
+        if (expired.empty()) {
+            continue;
+        }
+
+        // Gửi ping/đóng kết nối ngoài khóa để watch() từ luồng reactor không phải chờ
+        lock.unlock();
+        for (const WatchedConnection &watched : expired) {
+            ConnectionPtr conn = watched.lock();
+            if (!conn) {
+                continue;
+            }
+            int64_t next = check(conn, now);
+            if (next >= 0) {
+                rescheduled.emplace_back(next, std::move(conn));
+            }
+        }
+        expired.clear();
+        lock.lock();
+
+        for (auto &entry : rescheduled) {
+            m_wheel.schedule(tickAt(entry.first), std::move(entry.second));
+        }
+        rescheduled.clear();
+    }
+}
+
+// Client hỏi server còn sống không
+QJsonObject handlePing(const Request &request, SOCKET clientSocket)
+{
+    QJsonObject response = {{"action", "pong"}};
+    sendJsonResponse(clientSocket, response);
+    return response;
+}
+
+// Trả lời ping của server; luồng đọc đã ghi nhận hoạt động nên không cần làm gì thêm
+QJsonObject handlePong(const Request &request, SOCKET clientSocket)
+{
+    return {};
+}
+
+void initHeartbeatHandlers(HandlerTable &handlers)
+{
+    handlers.add(Opcode::Ping, handlePing);
+    handlers.add(Opcode::Pong, handlePong);
+}
@@ -0,0 +1,67 @@
+#ifndef HEARTBEAT_H
+#define HEARTBEAT_H
+
+#include "connection.h"
+#include "handlertable.h"
+#include "timerwheel.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Đồng hồ đơn điệu (ms) dùng cho Connection::lastActivityMs
+inline int64_t monotonicMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// Phát hiện kết nối chết (client sập, NAT hết hạn) mà TCP không báo.
+// Luồng đọc chỉ ghi lại thời điểm nhận dữ liệu cuối cùng (một lần store atomic);
+// mỗi kết nối có đúng một timer trong timer wheel, hết hạn thì so với mốc đó:
+// im lặng quá pingIntervalMs thì gửi "ping", quá idleTimeoutMs thì đóng kết nối,
+// còn lại hẹn lại theo mốc mới. Không có luồng riêng hay quét tuần tự theo kết nối.
+class HeartbeatMonitor
+{
+public:
+    HeartbeatMonitor(int pingIntervalMs, int idleTimeoutMs, int tickMs);
+    ~HeartbeatMonitor();
+
+    HeartbeatMonitor(const HeartbeatMonitor &) = delete;
+    HeartbeatMonitor &operator=(const HeartbeatMonitor &) = delete;
+
+    // Gọi một lần khi nhận kết nối mới
+    void watch(const ConnectionPtr &conn);
+
+    int pingIntervalMs() const { return m_pingIntervalMs; }
+    int idleTimeoutMs() const { return m_idleTimeoutMs; }
+    uint64_t reapedCount() const { return m_reaped.load(std::memory_order_relaxed); }
+
+private:
+    typedef std::weak_ptr<Connection> WatchedConnection;
+
+    void run();
+    // Trả về mốc (ms) cần kiểm tra lại, -1 nếu không theo dõi kết nối này nữa
+    int64_t check(const ConnectionPtr &conn, int64_t nowMs);
+    uint64_t tickAt(int64_t ms) const;
+
+    const int m_pingIntervalMs;
+    const int m_idleTimeoutMs;
+    const int m_tickMs;
+    const int64_t m_startMs;
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    TimerWheel<WatchedConnection> m_wheel;
+    bool m_stopping = false;
+    std::atomic<uint64_t> m_reaped{0};
+};
+
+void initHeartbeatHandlers(HandlerTable &handlers);
+
+#endif // HEARTBEAT_H
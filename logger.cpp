@@ -0,0 +1,225 @@
+#include "logger.h"
+#include "config.h"
+#include "lockfreequeue.h"
+#include <QDir>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+struct LogRecord
+{
+    std::time_t time = 0;
+    std::string message;
+};
+
+std::tm localTime(std::time_t t)
+{
+    std::tm tm;
+#ifdef _WIN32
+    localtime_s(&tm, &t);
+#else
+    localtime_r(&t, &tm);
+#endif
+    return tm;
+}
+
+class AsyncLogger
+{
+public:
+    AsyncLogger()
+        : m_queue(serverConfig().logQueueCapacity)
+    {}
+
+    void start()
+    {
+        QDir().mkpath("logs");
+        openNewFile(std::time(nullptr));
+        m_running = true;
+        m_thread = std::thread(&AsyncLogger::run, this);
+    }
+
+    void stop()
+    {
+        if (!m_running.exchange(false)) {
+            return;
+        }
+        m_cond.notify_one();
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+    }
+
+    void push(const std::string &message)
+    {
+        LogRecord record;
+        record.time = std::time(nullptr);
+        record.message = message;
+        if (!m_queue.tryPush(std::move(record))) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        // Chỉ đánh thức luồng ghi khi hàng đợi đã khá đầy; bình thường nó tự thức theo chu kỳ
+        if (m_queue.sizeApprox() >= m_queue.capacity() / 2) {
+            m_cond.notify_one();
+        }
+    }
+
+    uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+    void run()
+    {
+        const auto interval = std::chrono::milliseconds(serverConfig().logFlushIntervalMs);
+        while (true) {
+            bool running = m_running.load();
+            drain();
+            if (!running) {
+                break;
+            }
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait_for(lock, interval);
+        }
+        m_file.close();
+    }
+
+    // Ghi toàn bộ những gì đang có trong hàng đợi thành một lô rồi flush một lần
+    void drain()
+    {
+        std::string batch;
+        LogRecord record;
+        while (m_queue.tryPop(record)) {
+            appendLine(batch, record.time, record.message);
+        }
+
+        uint64_t dropped = m_dropped.load(std::memory_order_relaxed);
+        if (dropped != m_reportedDropped) {
+            appendLine(batch,
+                       std::time(nullptr),
+                       std::to_string(dropped - m_reportedDropped)
+                           + " log messages dropped (queue full).");
+            m_reportedDropped = dropped;
+        }
+
+        if (batch.empty()) {
+            return;
+        }
+        rotateIfNeeded(std::time(nullptr));
+        if (m_file.is_open()) {
+            m_file.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+            m_file.flush();
+            m_fileSize += batch.size();
+        }
+    }
+
+    void appendLine(std::string &batch, std::time_t time, const std::string &message)
+    {
+        // Chuỗi thời gian chỉ được định dạng lại khi sang giây mới
+        if (time != m_cachedTime) {
+            std::tm tm = localTime(time);
+            char buffer[32];
+            std::strftime(buffer, sizeof(buffer), "[%Y-%m-%d %H:%M:%S] ", &tm);
+            m_cachedStamp = buffer;
+            m_cachedTime = time;
+        }
+        batch += m_cachedStamp;
+        batch += message;
+        batch += '\n';
+    }
+
+    void rotateIfNeeded(std::time_t now)
+    {
+        const ServerConfig &config = serverConfig();
+        bool tooBig = m_fileSize >= static_cast<uint64_t>(config.logMaxFileSize);
+        bool tooOld = config.logRotateMinutes > 0
+                      && now - m_fileOpenedAt >= static_cast<std::time_t>(config.logRotateMinutes) * 60;
+        if (tooBig || tooOld) {
+            openNewFile(now);
+        }
+    }
+
+    void openNewFile(std::time_t now)
+    {
+        if (m_file.is_open()) {
+            m_file.close();
+        }
+
+        std::tm tm = localTime(now);
+        char stamp[32];
+        std::strftime(stamp, sizeof(stamp), "%Y-%m-%d_%H-%M-%S", &tm);
+        std::string filename = std::string("logs/server_log_") + stamp;
+        // Xoay vòng nhiều lần trong cùng một giây thì thêm số thứ tự
+        if (filename == m_lastBaseName) {
+            filename += "_" + std::to_string(++m_sameSecondIndex);
+        } else {
+            m_lastBaseName = filename;
+            m_sameSecondIndex = 0;
+        }
+        filename += ".txt";
+
+        m_file.open(filename, std::ios::out | std::ios::app);
+        m_fileSize = 0;
+        m_fileOpenedAt = now;
+        if (!m_file.is_open()) {
+            std::cerr << "Failed to create log file: " << filename << std::endl;
+        }
+    }
+
+    LockFreeQueue<LogRecord> m_queue;
+    std::atomic<uint64_t> m_dropped{0};
+    std::atomic<bool> m_running{false};
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+
+    // Chỉ luồng ghi log dùng các biến dưới đây
+    std::ofstream m_file;
+    uint64_t m_fileSize = 0;
+    std::time_t m_fileOpenedAt = 0;
+    std::string m_lastBaseName;
+    int m_sameSecondIndex = 0;
+    std::time_t m_cachedTime = 0;
+    std::string m_cachedStamp;
+    uint64_t m_reportedDropped = 0;
+};
+
+std::unique_ptr<AsyncLogger> logger;
+
+} // namespace
+
+void initLog()
+{
+    if (logger) {
+        return;
+    }
+    logger = std::make_unique<AsyncLogger>();
+    logger->start();
+    logMessage("Server started.");
+}
+
+void logMessage(const std::string &message)
+{
+    if (logger) {
+        logger->push(message);
+    }
+}
+
+void shutdownLog()
+{
+    if (logger) {
+        logMessage("Server stopped.");
+        logger->stop();
+    }
+}
+
+uint64_t droppedLogMessages()
+{
+    return logger ? logger->dropped() : 0;
+}
@@ -0,0 +1,18 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <cstdint>
+#include <string>
+
+// Ghi log bất đồng bộ: logMessage() chỉ đẩy dòng log vào hàng đợi không khóa,
+// một luồng nền gom nhiều dòng và ghi xuống logs/server_log_*.txt theo lô.
+// Khi hàng đợi đầy, dòng log bị bỏ (và được đếm) thay vì chặn luồng xử lý request.
+void initLog();
+void logMessage(const std::string &message);
+// Ghi nốt các dòng còn trong hàng đợi rồi dừng luồng nền
+void shutdownLog();
+
+// Số dòng log bị bỏ vì hàng đợi đầy kể từ khi khởi động
+uint64_t droppedLogMessages();
+
+#endif // LOGGER_H
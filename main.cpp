@@ -8,14 +8,21 @@ int main(int argc, char *argv[])
 
     initLog();
 
-    QQmlApplicationEngine engine;
-    QObject::connect(
-        &engine,
-        &QQmlApplicationEngine::objectCreationFailed,
-        &app,
-        []() { QCoreApplication::exit(-1); },
-        Qt::QueuedConnection);
-    engine.loadFromModule("Server", "Main");
+    int result = 0;
+    {
+        // Server nằm trong cây QML: hủy engine (và Server cùng pool, MessageWriter của nó)
+        // trong khối này để mọi log lúc tắt được ghi trước khi dừng logger
+        QQmlApplicationEngine engine;
+        QObject::connect(
+            &engine,
+            &QQmlApplicationEngine::objectCreationFailed,
+            &app,
+            []() { QCoreApplication::exit(-1); },
+            Qt::QueuedConnection);
+        engine.loadFromModule("Server", "Main");
 
-    return app.exec();
+        result = app.exec();
+    }
+    shutdownLog();
+    return result;
 }
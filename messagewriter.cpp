@@ -0,0 +1,307 @@
+#include "messagewriter.h"
+#include "config.h"
+#include "database.h"
+#include <QDebug>
+#include <QSqlError>
+#include <algorithm>
+#include <chrono>
+
+// Lô ghi lỗi (database bị khóa, đĩa đầy...) được thử lại sau khoảng chờ tăng gấp đôi
+#define RETRY_BACKOFF_MIN_MS 50
+#define RETRY_BACKOFF_MAX_MS 5000
+// Khi server đang tắt chỉ thử lại chừng này lần rồi bỏ lô để không treo mãi
+#define MAX_SHUTDOWN_RETRIES 3
+// Mã lỗi SQLite (byte thấp của extended code) chỉ do chính dòng đang ghi gây ra
+#define SQLITE_TOOBIG_CODE 18
+#define SQLITE_CONSTRAINT_CODE 19
+#define SQLITE_MISMATCH_CODE 20
+
+// Lỗi của riêng một dòng (vi phạm ràng buộc, sai kiểu, quá lớn): ghi lại bao nhiêu lần cũng hỏng.
+// Các lỗi khác (SQLITE_BUSY/LOCKED, I/O, đĩa đầy) là tạm thời và cả lô được thử lại.
+static bool isRowError(const QSqlError &error)
+{
+    bool ok = false;
+    int code = error.nativeErrorCode().toInt(&ok) & 0xff;
+    return ok && (code == SQLITE_TOOBIG_CODE || code == SQLITE_CONSTRAINT_CODE || code == SQLITE_MISMATCH_CODE);
+}
+
+MessageWriter::MessageWriter(const std::string &dbName)
+    : m_dbName(dbName)
+{
+    // MessageID và GroupMessageID do server cấp nên phải tiếp nối ID lớn nhất đã có trong database
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "MessageIdConnection");
+    db.setDatabaseName(QString::fromStdString(dbName));
+    if (db.open()) {
+        configureConnection(db);
+        QSqlQuery query(db);
+        if (query.exec("select ifnull(max(MessageID), 0) from Messages;") && query.next()) {
+            m_committedId = query.value(0).toLongLong();
+        }
+        query.finish();
+        if (query.exec("select ifnull(max(GroupMessageID), 0) from GroupMessages;") && query.next()) {
+            m_committedGroupId = query.value(0).toLongLong();
+        }
+        query.finish();
+        db.close();
+    } else {
+        qDebug() << "Failed to open database for message IDs:" << db.lastError().text();
+    }
+    db = QSqlDatabase();
+    QSqlDatabase::removeDatabase("MessageIdConnection");
+
+    m_nextId = m_committedId + 1;
+    m_lastAllocatedId = m_committedId;
+    m_nextGroupId = m_committedGroupId + 1;
+    m_lastAllocatedGroupId = m_committedGroupId;
+    m_thread = std::thread(&MessageWriter::run, this);
+}
+
+MessageWriter::~MessageWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_cond.notify_one();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+qint64 MessageWriter::enqueue(int senderID,
+                              int receiverID,
+                              const QString &content,
+                              const QString &sentAt,
+                              CommitCallback onCommitted)
+{
+    qint64 messageId;
+    bool batchFull;
+    {
+        // Cấp ID trong cùng khóa với việc xếp hàng để hàng đợi luôn tăng dần theo ID
+        std::lock_guard<std::mutex> lock(m_mutex);
+        messageId = m_nextId++;
+        m_lastAllocatedId = messageId;
+        batchFull = pushLocked({messageId, 0, senderID, receiverID, content, sentAt, std::move(onCommitted)});
+    }
+    if (batchFull) {
+        m_cond.notify_one();
+    }
+    return messageId;
+}
+
+qint64 MessageWriter::enqueueGroup(int groupID,
+                                   int senderID,
+                                   const QString &content,
+                                   const QString &sentAt,
+                                   CommitCallback onCommitted)
+{
+    qint64 groupMessageId;
+    bool batchFull;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        groupMessageId = m_nextGroupId++;
+        m_lastAllocatedGroupId = groupMessageId;
+        batchFull = pushLocked({groupMessageId, groupID, senderID, 0, content, sentAt, std::move(onCommitted)});
+    }
+    if (batchFull) {
+        m_cond.notify_one();
+    }
+    return groupMessageId;
+}
+
+bool MessageWriter::pushLocked(PendingMessage message)
+{
+    m_pending.push_back(std::move(message));
+    return m_pending.size() >= static_cast<size_t>(serverConfig().messageBatchSize);
+}
+
+void MessageWriter::waitForCommit(qint64 messageId)
+{
+    waitUntil(m_committedId, messageId);
+}
+
+void MessageWriter::waitForGroupCommit(qint64 groupMessageId)
+{
+    waitUntil(m_committedGroupId, groupMessageId);
+}
+
+void MessageWriter::waitUntil(const qint64 &committedId, qint64 messageId)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (committedId >= messageId || m_stopping) {
+        return;
+    }
+    // Không chờ hết batchDelayMs: yêu cầu luồng ghi commit lô hiện tại ngay
+    m_flushRequested = true;
+    m_cond.notify_one();
+    m_committedCond.wait_for(lock,
+                             std::chrono::milliseconds(serverConfig().messageBatchDelayMs * 4 + 1000),
+                             [this, &committedId, messageId] { return committedId >= messageId || m_stopping; });
+}
+
+void MessageWriter::run()
+{
+    const auto delay = std::chrono::milliseconds(serverConfig().messageBatchDelayMs);
+    const size_t batchSize = static_cast<size_t>(serverConfig().messageBatchSize);
+    int backoffMs = 0;
+    int shutdownRetries = 0;
+
+    while (true) {
+        std::vector<PendingMessage> batch;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait(lock, [this] { return m_stopping || !m_pending.empty(); });
+            // Tin đầu tiên của lô chờ tối đa batchDelayMs để gom thêm tin khác
+            m_cond.wait_for(lock, delay, [this, batchSize] {
+                return m_stopping || m_flushRequested || m_pending.size() >= batchSize;
+            });
+            m_flushRequested = false;
+            if (m_pending.empty() && m_stopping) {
+                break;
+            }
+            if (m_pending.size() <= batchSize) {
+                batch.swap(m_pending);
+            } else {
+                batch.assign(std::make_move_iterator(m_pending.begin()),
+                             std::make_move_iterator(m_pending.begin() + batchSize));
+                m_pending.erase(m_pending.begin(), m_pending.begin() + batchSize);
+            }
+        }
+
+        std::vector<bool> rejected(batch.size(), false);
+        if (!writeBatch(batch, rejected)) {
+            // Tin bị từ chối không bao giờ ghi được: báo lỗi ngay, chỉ thử lại phần còn lại
+            std::vector<PendingMessage> retry;
+            for (size_t i = 0; i < batch.size(); ++i) {
+                if (!rejected[i]) {
+                    retry.push_back(std::move(batch[i]));
+                } else if (batch[i].onCommitted) {
+                    batch[i].onCommitted(batch[i].messageId, false);
+                }
+            }
+            batch.swap(retry);
+            if (batch.empty()) {
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_stopping && ++shutdownRetries > MAX_SHUTDOWN_RETRIES) {
+                lock.unlock();
+                qDebug() << "Giving up on" << batch.size() << "messages from ID" << batch.front().messageId
+                         << "while shutting down.";
+                for (const PendingMessage &message : batch) {
+                    if (message.onCommitted) {
+                        message.onCommitted(message.messageId, false);
+                    }
+                }
+                continue;
+            }
+            // Tin đã được cấp ID và chuyển cho người nhận: không được bỏ, đưa cả lô về đầu
+            // hàng đợi (ID vẫn tăng dần) và không tăng m_committedId cho tới khi commit được
+            m_pending.insert(m_pending.begin(),
+                             std::make_move_iterator(batch.begin()),
+                             std::make_move_iterator(batch.end()));
+            backoffMs = std::min(RETRY_BACKOFF_MAX_MS, std::max(RETRY_BACKOFF_MIN_MS, backoffMs * 2));
+            qDebug() << "Message batch failed, retrying" << m_pending.size() << "messages in" << backoffMs << "ms";
+            m_cond.wait_for(lock, std::chrono::milliseconds(backoffMs), [this] { return m_stopping; });
+            continue;
+        }
+        backoffMs = 0;
+        shutdownRetries = 0;
+
+        {
+            // Mỗi dãy ID tăng dần trong hàng đợi nên tin sau cùng của mỗi loại là lớn nhất.
+            // Tin bị từ chối cũng đã xong, mốc vượt qua nó để người đọc không phải chờ.
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (const PendingMessage &message : batch) {
+                (message.groupID != 0 ? m_committedGroupId : m_committedId) = message.messageId;
+            }
+        }
+        m_committedCond.notify_all();
+
+        for (size_t i = 0; i < batch.size(); ++i) {
+            if (batch[i].onCommitted) {
+                batch[i].onCommitted(batch[i].messageId, !rejected[i]);
+            }
+        }
+    }
+}
+
+bool MessageWriter::writeBatch(const std::vector<PendingMessage> &batch, std::vector<bool> &rejected)
+{
+    QSqlDatabase &db = threadDatabase(m_dbName);
+    // Gặp dòng hỏng thì rollback, đánh dấu dòng đó rồi ghi lại phần còn lại;
+    // mỗi vòng loại thêm một dòng nên số vòng không vượt quá kích thước lô
+    while (true) {
+        if (!db.isOpen() || !db.transaction()) {
+            qDebug() << "Failed to begin message batch:" << db.lastError().text();
+            return false;
+        }
+
+        int badRow = -1;
+        bool transientError = false;
+        {
+            PooledQuery query(m_dbName,
+                              "insert into Messages "
+                              "(MessageID, SenderID, ReceiverID, Content, SentAt, ConversationKey) "
+                              "values (:MessageID, :SenderID, :ReceiverID, :Content, :SentAt, :ConversationKey);");
+            PooledQuery groupQuery(m_dbName,
+                                   "insert into GroupMessages (GroupMessageID, GroupID, SenderID, Content, SentAt) "
+                                   "values (:GroupMessageID, :GroupID, :SenderID, :Content, :SentAt);");
+            if (!query.isValid() || !groupQuery.isValid()) {
+                db.rollback();
+                return false;
+            }
+            for (size_t i = 0; i < batch.size(); ++i) {
+                if (rejected[i]) {
+                    continue;
+                }
+                const PendingMessage &message = batch[i];
+                QSqlQuery &insert = message.groupID != 0 ? *groupQuery : *query;
+                if (message.groupID != 0) {
+                    insert.bindValue(":GroupMessageID", message.messageId);
+                    insert.bindValue(":GroupID", message.groupID);
+                } else {
+                    insert.bindValue(":MessageID", message.messageId);
+                    insert.bindValue(":ReceiverID", message.receiverID);
+                    insert.bindValue(":ConversationKey", conversationKey(message.senderID, message.receiverID));
+                }
+                insert.bindValue(":SenderID", message.senderID);
+                insert.bindValue(":Content", message.content);
+                insert.bindValue(":SentAt", message.sentAt);
+                if (insert.exec()) {
+                    continue;
+                }
+
+                QSqlError error = insert.lastError();
+                if (isRowError(error)) {
+                    qDebug() << "Rejecting message" << message.messageId << ":" << error.text();
+                    badRow = static_cast<int>(i);
+                } else {
+                    qDebug() << "Inserting message failed:" << error.text();
+                    transientError = true;
+                }
+                query->finish();
+                groupQuery->finish();
+                break;
+            }
+        }
+
+        if (transientError) {
+            db.rollback();
+            return false;
+        }
+        if (badRow >= 0) {
+            db.rollback();
+            rejected[badRow] = true;
+            continue;
+        }
+        if (!db.commit()) {
+            qDebug() << "Committing message batch failed:" << db.lastError().text();
+            db.rollback();
+            return false;
+        }
+        qDebug() << "Committed" << batch.size() << "messages.";
+        return true;
+    }
+}
@@ -0,0 +1,96 @@
+#ifndef MESSAGEWRITER_H
+#define MESSAGEWRITER_H
+
+#include <QString>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Khóa hội thoại giữa hai người dùng, không phụ thuộc ai là người gửi:
+// (min(a, b) << 32) | max(a, b). Lưu ở cột Messages.ConversationKey.
+inline qint64 conversationKey(int userA, int userB)
+{
+    qint64 low = std::min(userA, userB);
+    qint64 high = std::max(userA, userB);
+    return (low << 32) | high;
+}
+
+// Ghi tin nhắn xuống bảng Messages (và tin nhóm xuống GroupMessages) theo kiểu
+// write-behind: tin được cấp ID ngay trong bộ nhớ, một luồng nền gom nhiều tin vào một
+// transaction (tối đa batchSize tin hoặc sau batchDelayMs) nên chỉ tốn một lần fsync cho cả lô.
+// MessageID và GroupMessageID là hai dãy riêng, mỗi dãy tăng dần theo thứ tự trong hàng đợi.
+class MessageWriter
+{
+public:
+    // Gọi trên luồng ghi sau khi lô chứa tin đã commit (ok = true) hoặc thất bại
+    typedef std::function<void(qint64 messageId, bool ok)> CommitCallback;
+
+    explicit MessageWriter(const std::string &dbName);
+    ~MessageWriter();
+
+    MessageWriter(const MessageWriter &) = delete;
+    MessageWriter &operator=(const MessageWriter &) = delete;
+
+    // Xếp tin vào hàng đợi, trả về MessageID đã cấp
+    qint64 enqueue(int senderID,
+                   int receiverID,
+                   const QString &content,
+                   const QString &sentAt,
+                   CommitCallback onCommitted = CommitCallback());
+
+    // Như enqueue nhưng cho tin nhóm, trả về GroupMessageID đã cấp
+    qint64 enqueueGroup(int groupID,
+                        int senderID,
+                        const QString &content,
+                        const QString &sentAt,
+                        CommitCallback onCommitted = CommitCallback());
+
+    // Chờ cho đến khi mọi tin có ID <= messageId đã được ghi (đọc lại ngay sau khi gửi)
+    void waitForCommit(qint64 messageId);
+    void waitForGroupCommit(qint64 groupMessageId);
+    qint64 lastAllocatedId() const { return m_lastAllocatedId.load(); }
+    qint64 lastAllocatedGroupId() const { return m_lastAllocatedGroupId.load(); }
+
+private:
+    struct PendingMessage
+    {
+        qint64 messageId;
+        // 0 = tin giữa hai người (receiverID), khác 0 = tin nhóm (messageId là GroupMessageID)
+        int groupID;
+        int senderID;
+        int receiverID;
+        QString content;
+        QString sentAt;
+        CommitCallback onCommitted;
+    };
+
+    void run();
+    // Ghi lô trong một transaction. Dòng lỗi vĩnh viễn được đánh dấu trong rejected và bỏ qua;
+    // false khi gặp lỗi tạm thời (database bận/khóa...), cần thử lại các dòng chưa bị từ chối
+    bool writeBatch(const std::vector<PendingMessage> &batch, std::vector<bool> &rejected);
+    // Trả về true khi hàng đợi đã đủ một lô
+    bool pushLocked(PendingMessage message);
+    void waitUntil(const qint64 &committedId, qint64 messageId);
+
+    std::string m_dbName;
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::condition_variable m_committedCond;
+    std::vector<PendingMessage> m_pending;
+    bool m_stopping = false;
+    bool m_flushRequested = false;
+    qint64 m_nextId = 1;
+    std::atomic<qint64> m_lastAllocatedId{0};
+    qint64 m_committedId = 0;
+    qint64 m_nextGroupId = 1;
+    std::atomic<qint64> m_lastAllocatedGroupId{0};
+    qint64 m_committedGroupId = 0;
+};
+
+#endif // MESSAGEWRITER_H
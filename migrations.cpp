@@ -0,0 +1,165 @@
+#include "migrations.h"
+#include <QDebug>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QStringList>
+#include <vector>
+
+namespace {
+
+struct Migration
+{
+    int version;
+    const char *description;
+    QStringList statements;
+};
+
+// Chỉ được thêm bước mới vào cuối danh sách, không sửa các bước đã phát hành.
+// Database.sql chứa schema của bước cuối và đặt PRAGMA user_version bằng version của bước đó.
+const std::vector<Migration> &migrations()
+{
+    static const std::vector<Migration> list = {
+        {1,
+         "initial schema",
+         QStringList()
+             << "create table if not exists Users ("
+                "UserID INTEGER PRIMARY KEY AUTOINCREMENT,"
+                "Username TEXT not null unique,"
+                "PasswordHash TEXT not null,"
+                "Status INTEGER default 0,"
+                "CreatedAt DATETIME default CURRENT_TIMESTAMP"
+                ");"
+             << "create table if not exists Messages ("
+                "MessageID INTEGER PRIMARY KEY AUTOINCREMENT,"
+                "SenderID INTEGER not null,"
+                "ReceiverID INTEGER not null,"
+                "Content TEXT not null,"
+                "SentAt DATETIME default CURRENT_TIMESTAMP,"
+                "foreign key (SenderID) references Users(UserID),"
+                "foreign key (ReceiverID) references Users(UserID)"
+                ");"
+             << "create table if not exists Friendships ("
+                "UserID1 INTEGER not null,"
+                "UserID2 INTEGER not null,"
+                "Status INTEGER not null,"
+                "CreatedAt DATETIME default CURRENT_TIMESTAMP,"
+                "primary key (UserID1, UserID2),"
+                "foreign key (UserID1) references Users(UserID),"
+                "foreign key (UserID2) references Users(UserID)"
+                ");"
+             << "create table if not exists Groups ("
+                "GroupID INTEGER PRIMARY KEY AUTOINCREMENT,"
+                "GroupName TEXT not null,"
+                "CreatedAt DATETIME default CURRENT_TIMESTAMP"
+                ");"
+             << "create table if not exists GroupMembers ("
+                "GroupID INTEGER not null,"
+                "UserID INTEGER not null,"
+                "JoinedAt DATETIME default CURRENT_TIMESTAMP,"
+                "primary key (GroupID, UserID),"
+                "foreign key (GroupID) references Groups(GroupID),"
+                "foreign key (UserID) references Users(UserID)"
+                ");"
+             << "create table if not exists GroupMessages ("
+                "GroupMessageID INTEGER PRIMARY KEY AUTOINCREMENT,"
+                "GroupID INTEGER not null,"
+                "SenderID INTEGER not null,"
+                "Content TEXT not null,"
+                "SentAt DATETIME default CURRENT_TIMESTAMP,"
+                "foreign key (GroupID) references Groups(GroupID),"
+                "foreign key (SenderID) references Users(UserID)"
+                ");"},
+        {2,
+         "conversation key and index on Messages",
+         QStringList()
+             << "alter table Messages add column ConversationKey INTEGER;"
+             // Khóa hội thoại = (min(a, b) << 32) | max(a, b), giống conversationKey()
+             << "update Messages set ConversationKey = "
+                "(min(SenderID, ReceiverID) << 32) | max(SenderID, ReceiverID);"
+             << "create index if not exists idx_messages_conversation "
+                "on Messages (ConversationKey, MessageID);"},
+        {3,
+         "sender/receiver indexes for message sync",
+         QStringList()
+             << "create index if not exists idx_messages_receiver "
+                "on Messages (ReceiverID, MessageID);"
+             << "create index if not exists idx_messages_sender "
+                "on Messages (SenderID, MessageID);"},
+        {4,
+         "group message history index",
+         QStringList()
+             << "create index if not exists idx_groupmessages_group "
+                "on GroupMessages (GroupID, GroupMessageID);"},
+        {5,
+         "delivery and read watermarks",
+         QStringList()
+             << "create table if not exists DeliveryState ("
+                "UserID INTEGER PRIMARY KEY,"
+                "LastDeliveredID INTEGER not null default 0,"
+                "foreign key (UserID) references Users(UserID)"
+                ");"
+             << "create table if not exists ReadState ("
+                "UserID INTEGER not null,"
+                "PeerID INTEGER not null,"
+                "LastReadID INTEGER not null default 0,"
+                "primary key (UserID, PeerID),"
+                "foreign key (UserID) references Users(UserID),"
+                "foreign key (PeerID) references Users(UserID)"
+                ");"
+             // Tin nhắn có từ trước khi có bảng này coi như đã giao
+             << "insert into DeliveryState (UserID, LastDeliveredID) "
+                "select UserID, (select ifnull(max(MessageID), 0) from Messages) from Users;"},
+    };
+    return list;
+}
+
+int schemaVersion(QSqlDatabase &db)
+{
+    QSqlQuery query(db);
+    if (query.exec("PRAGMA user_version;") && query.next()) {
+        return query.value(0).toInt();
+    }
+    return 0;
+}
+
+} // namespace
+
+bool migrateDatabase(QSqlDatabase &db)
+{
+    int current = schemaVersion(db);
+    for (const Migration &migration : migrations()) {
+        if (migration.version <= current) {
+            continue;
+        }
+
+        qDebug() << "Migrating database to version" << migration.version << ":" << migration.description;
+        if (!db.transaction()) {
+            qDebug() << "Failed to begin migration:" << db.lastError().text();
+            return false;
+        }
+
+        QSqlQuery query(db);
+        bool ok = true;
+        for (const QString &statement : migration.statements) {
+            if (!query.exec(statement)) {
+                qDebug() << "Migration statement failed:" << query.lastError().text();
+                ok = false;
+                break;
+            }
+        }
+        // user_version nằm trong header của file nên được ghi cùng transaction
+        if (ok && !query.exec(QString("PRAGMA user_version = %1;").arg(migration.version))) {
+            qDebug() << "Failed to update schema version:" << query.lastError().text();
+            ok = false;
+        }
+        query.finish();
+
+        if (!ok || !db.commit()) {
+            db.rollback();
+            return false;
+        }
+        current = migration.version;
+    }
+    qDebug() << "Database schema version:" << current;
+    return true;
+}
@@ -0,0 +1,11 @@
+#ifndef MIGRATIONS_H
+#define MIGRATIONS_H
+
+#include <QSqlDatabase>
+
+// Đưa schema lên phiên bản mới nhất. Phiên bản hiện tại lưu trong PRAGMA user_version,
+// mỗi bước migrate chạy trong một transaction riêng nên file ChatApp.db cũ được
+// nâng cấp tự động khi server khởi động.
+bool migrateDatabase(QSqlDatabase &db);
+
+#endif // MIGRATIONS_H
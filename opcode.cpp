@@ -0,0 +1,144 @@
+#include "opcode.h"
+#include <QDebug>
+#include <QLatin1String>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+const char *const actionNames[] = {
+    nullptr,
+#define ACTION_NAME(op, name, rateClass) name,
+    ACTION_LIST(ACTION_NAME)
+#undef ACTION_NAME
+};
+
+const RateClass actionRateClasses[] = {
+    RateClass::Control,
+#define ACTION_RATE_CLASS(op, name, rateClass) RateClass::rateClass,
+    ACTION_LIST(ACTION_RATE_CLASS)
+#undef ACTION_RATE_CLASS
+};
+
+// FNV-1a trên các ký tự của tên action, seed chọn sao cho không có va chạm
+uint32_t hashAction(const QChar *chars, qsizetype length, uint32_t seed)
+{
+    uint32_t hash = 2166136261u ^ seed;
+    for (qsizetype i = 0; i < length; ++i) {
+        hash ^= chars[i].unicode();
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+uint32_t hashAction(const char *name, size_t length, uint32_t seed)
+{
+    uint32_t hash = 2166136261u ^ seed;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= static_cast<unsigned char>(name[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+struct ActionTable
+{
+    uint32_t seed = 0;
+    uint32_t mask = 0;
+    // Mỗi ô chứa opcode (0 = trống)
+    std::vector<uint8_t> buckets;
+};
+
+ActionTable buildTable()
+{
+    const size_t count = static_cast<size_t>(Opcode::Count);
+    size_t size = 1;
+    while (size < count * 4) {
+        size <<= 1;
+    }
+
+    ActionTable table;
+    table.mask = static_cast<uint32_t>(size - 1);
+    for (uint32_t seed = 1;; ++seed) {
+        table.buckets.assign(size, 0);
+        bool collision = false;
+        for (size_t op = 1; op < count && !collision; ++op) {
+            uint8_t &slot = table.buckets[hashAction(actionNames[op], strlen(actionNames[op]), seed) & table.mask];
+            collision = slot != 0;
+            slot = static_cast<uint8_t>(op);
+        }
+        if (!collision) {
+            table.seed = seed;
+            return table;
+        }
+    }
+}
+
+const ActionTable &actionTable()
+{
+    static const ActionTable table = buildTable();
+    return table;
+}
+
+} // namespace
+
+void buildActionTable()
+{
+    const ActionTable &table = actionTable();
+    qDebug() << "Action table:" << static_cast<int>(Opcode::Count) - 1 << "actions in" << table.buckets.size()
+             << "buckets, seed" << table.seed;
+}
+
+Opcode opcodeForAction(const QString &action)
+{
+    const ActionTable &table = actionTable();
+    uint8_t op = table.buckets[hashAction(action.constData(), action.size(), table.seed) & table.mask];
+    if (op == 0 || action != QLatin1String(actionNames[op])) {
+        return Opcode::Unknown;
+    }
+    return static_cast<Opcode>(op);
+}
+
+Opcode opcodeForAction(const char *action, size_t length)
+{
+    const ActionTable &table = actionTable();
+    uint8_t op = table.buckets[hashAction(action, length, table.seed) & table.mask];
+    if (op == 0 || strlen(actionNames[op]) != length || memcmp(action, actionNames[op], length) != 0) {
+        return Opcode::Unknown;
+    }
+    return static_cast<Opcode>(op);
+}
+
+const char *actionName(Opcode opcode)
+{
+    size_t op = static_cast<size_t>(opcode);
+    if (op == 0 || op >= static_cast<size_t>(Opcode::Count)) {
+        return "unknown";
+    }
+    return actionNames[op];
+}
+
+RateClass rateClassOf(Opcode opcode)
+{
+    size_t op = static_cast<size_t>(opcode);
+    if (op >= static_cast<size_t>(Opcode::Count)) {
+        return RateClass::Control;
+    }
+    return actionRateClasses[op];
+}
+
+const char *rateClassName(RateClass rateClass)
+{
+    switch (rateClass) {
+    case RateClass::Auth:
+        return "auth";
+    case RateClass::Message:
+        return "message";
+    case RateClass::Query:
+        return "query";
+    case RateClass::Social:
+        return "social";
+    default:
+        return "control";
+    }
+}
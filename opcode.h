@@ -0,0 +1,76 @@
+#ifndef OPCODE_H
+#define OPCODE_H
+
+#include <QString>
+#include <cstddef>
+#include <cstdint>
+
+// Danh sách action của giao thức: (opcode, tên action trong request, nhóm giới hạn tốc độ).
+// Thêm action mới ở đây rồi đăng ký handler bằng HandlerTable::add.
+#define ACTION_LIST(X) \
+    X(Hello, "hello", Control) \
+    X(Ping, "ping", Control) \
+    X(Pong, "pong", Control) \
+    X(Register, "register", Auth) \
+    X(Login, "login", Auth) \
+    X(Logout, "logout", Control) \
+    X(ResumeSession, "resumeSession", Auth) \
+    X(SendMessage, "sendMessage", Message) \
+    X(GetAllMessages, "getAllMessages", Query) \
+    X(GetMessageHistory, "getMessageHistory", Query) \
+    X(SyncMessages, "syncMessages", Query) \
+    X(AckDelivered, "ackDelivered", Control) \
+    X(MarkRead, "markRead", Control) \
+    X(GetAllUsers, "getAllUsers", Query) \
+    X(GetNonFriendUsers, "getNonFriendUsers", Query) \
+    X(SearchUsers, "searchUsers", Query) \
+    X(GetFriendRequests, "getFriendRequests", Query) \
+    X(FriendRequest, "friendRequest", Social) \
+    X(AcceptFriendRequest, "acceptFriendRequest", Social) \
+    X(QueryFriendStatus, "queryFriendStatus", Query) \
+    X(GetFriendsList, "getFriendsList", Query) \
+    X(Unfriend, "unfriend", Social) \
+    X(CreateGroup, "createGroup", Social) \
+    X(JoinGroup, "joinGroup", Social) \
+    X(LeaveGroup, "leaveGroup", Social) \
+    X(GetGroups, "getGroups", Query) \
+    X(SendGroupMessage, "sendGroupMessage", Message) \
+    X(GetGroupMessages, "getGroupMessages", Query)
+
+// Nhóm action dùng chung một token bucket khi giới hạn tốc độ (xem ratelimit.h)
+enum class RateClass : uint8_t {
+    // Đăng ký, đăng nhập: tốn CPU băm mật khẩu
+    Auth,
+    // Gửi tin nhắn, ghi xuống database và phát cho người nhận
+    Message,
+    // Đọc danh sách, lịch sử
+    Query,
+    // Kết bạn, nhóm: ghi database và gửi sự kiện cho người khác
+    Social,
+    // hello, ping/pong, logout, xác nhận đã nhận/đã đọc và action không xác định
+    Control,
+    Count
+};
+
+enum class Opcode : uint8_t {
+    Unknown = 0,
+#define DECLARE_OPCODE(op, name, rateClass) op,
+    ACTION_LIST(DECLARE_OPCODE)
+#undef DECLARE_OPCODE
+    Count
+};
+
+// Dựng bảng băm hoàn hảo tên action -> opcode; gọi một lần khi server khởi động
+void buildActionTable();
+
+// Tra tên action: một lần băm và một lần so sánh chuỗi, Opcode::Unknown nếu không có
+Opcode opcodeForAction(const QString &action);
+// Như trên, với tên action dạng byte (ASCII) lấy thẳng từ payload chưa giải mã
+Opcode opcodeForAction(const char *action, size_t length);
+const char *actionName(Opcode opcode);
+
+RateClass rateClassOf(Opcode opcode);
+// Tên nhóm dùng trong server.ini và log, ví dụ "message"
+const char *rateClassName(RateClass rateClass);
+
+#endif // OPCODE_H
@@ -0,0 +1,64 @@
+#include "passwordhash.h"
+#include "config.h"
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QPasswordDigestor>
+#include <QRandomGenerator>
+#include <QStringList>
+#include <iterator>
+
+#define HASH_SCHEME "pbkdf2-sha256"
+#define SALT_SIZE 16
+#define KEY_SIZE 32
+
+static QByteArray deriveKey(const QString &password, const QByteArray &salt, int iterations)
+{
+    return QPasswordDigestor::deriveKeyPbkdf2(QCryptographicHash::Sha256, password.toUtf8(), salt, iterations, KEY_SIZE);
+}
+
+// So sánh không dừng sớm ở byte khác đầu tiên, tránh lộ thông tin qua thời gian phản hồi
+static bool constantTimeEquals(const QByteArray &a, const QByteArray &b)
+{
+    if (a.size() != b.size()) {
+        return false;
+    }
+    unsigned char diff = 0;
+    for (qsizetype i = 0; i < a.size(); ++i) {
+        diff |= static_cast<unsigned char>(a[i] ^ b[i]);
+    }
+    return diff == 0;
+}
+
+QString hashPassword(const QString &password)
+{
+    quint32 saltWords[SALT_SIZE / sizeof(quint32)];
+    QRandomGenerator::system()->generate(std::begin(saltWords), std::end(saltWords));
+    QByteArray salt(reinterpret_cast<const char *>(saltWords), sizeof(saltWords));
+    int iterations = serverConfig().pbkdf2Iterations;
+    QByteArray key = deriveKey(password, salt, iterations);
+    return QString("%1$%2$%3$%4")
+        .arg(HASH_SCHEME)
+        .arg(iterations)
+        .arg(QString::fromLatin1(salt.toBase64()))
+        .arg(QString::fromLatin1(key.toBase64()));
+}
+
+bool verifyPassword(const QString &password, const QString &stored, bool &needsRehash)
+{
+    QStringList parts = stored.split('$');
+    if (parts.size() != 4 || parts[0] != HASH_SCHEME) {
+        // Tài khoản tạo trước khi có băm mật khẩu: PasswordHash đang là mật khẩu thô
+        needsRehash = true;
+        return constantTimeEquals(password.toUtf8(), stored.toUtf8());
+    }
+
+    int iterations = parts[1].toInt();
+    QByteArray salt = QByteArray::fromBase64(parts[2].toLatin1());
+    QByteArray expected = QByteArray::fromBase64(parts[3].toLatin1());
+    if (iterations <= 0 || salt.isEmpty() || expected.isEmpty()) {
+        needsRehash = false;
+        return false;
+    }
+    needsRehash = iterations < serverConfig().pbkdf2Iterations;
+    return constantTimeEquals(deriveKey(password, salt, iterations), expected);
+}
@@ -0,0 +1,15 @@
+#ifndef PASSWORDHASH_H
+#define PASSWORDHASH_H
+
+#include <QString>
+
+// Băm mật khẩu bằng PBKDF2-HMAC-SHA256 với salt ngẫu nhiên. Chuỗi lưu trong
+// Users.PasswordHash có dạng "pbkdf2-sha256$<số vòng>$<salt base64>$<hash base64>".
+// Cả hai hàm đều tốn CPU (cố ý) nên chỉ được gọi trên auth pool.
+QString hashPassword(const QString &password);
+
+// needsRehash = true khi chuỗi lưu là mật khẩu dạng thô (dữ liệu cũ) hoặc số vòng
+// thấp hơn cấu hình hiện tại: người gọi nên băm lại và cập nhật sau khi xác thực đúng.
+bool verifyPassword(const QString &password, const QString &stored, bool &needsRehash);
+
+#endif // PASSWORDHASH_H
@@ -0,0 +1,15 @@
+#include "platform.h"
+
+bool setNonBlocking(SOCKET s)
+{
+#ifdef _WIN32
+    u_long mode = 1;
+    return ioctlsocket(s, FIONBIO, &mode) == 0;
+#else
+    int flags = fcntl(s, F_GETFL, 0);
+    if (flags == -1) {
+        return false;
+    }
+    return fcntl(s, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
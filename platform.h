@@ -0,0 +1,61 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+// Lớp tương thích socket giữa Winsock (Windows) và BSD socket (Linux)
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#pragma comment(lib, "Ws2_32.lib")
+
+#define SOCKET_SEND_FLAGS 0
+
+inline int lastSocketError()
+{
+    return WSAGetLastError();
+}
+
+inline bool socketWouldBlock(int error)
+{
+    return error == WSAEWOULDBLOCK;
+}
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+typedef int SOCKET;
+
+#define INVALID_SOCKET (-1)
+#define SOCKET_ERROR (-1)
+#define SD_RECEIVE SHUT_RD
+#define SD_SEND SHUT_WR
+#define SD_BOTH SHUT_RDWR
+// Không để SIGPIPE giết tiến trình khi client đóng kết nối giữa chừng
+#define SOCKET_SEND_FLAGS MSG_NOSIGNAL
+
+inline int closesocket(SOCKET s)
+{
+    return ::close(s);
+}
+
+inline int lastSocketError()
+{
+    return errno;
+}
+
+inline bool socketWouldBlock(int error)
+{
+    return error == EAGAIN || error == EWOULDBLOCK;
+}
+#endif
+
+bool setNonBlocking(SOCKET s);
+
+#endif // PLATFORM_H
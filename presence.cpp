@@ -0,0 +1,136 @@
+#include "presence.h"
+#include "friendgraph.h"
+#include "server.h"
+#include <QDebug>
+#include <QJsonObject>
+#include <algorithm>
+
+bool PresenceRegistry::addSession(int userId, const ConnectionPtr &conn)
+{
+    Shard &shard = shardFor(userId);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    std::vector<ConnectionPtr> &connections = shard.sessions[userId];
+    if (std::find(connections.begin(), connections.end(), conn) == connections.end()) {
+        connections.push_back(conn);
+    }
+    return connections.size() == 1;
+}
+
+bool PresenceRegistry::removeSession(int userId, const Connection *conn)
+{
+    Shard &shard = shardFor(userId);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    auto it = shard.sessions.find(userId);
+    if (it == shard.sessions.end()) {
+        return false;
+    }
+    // Mỗi người dùng chỉ có vài phiên nên tìm tuyến tính trong vector là đủ
+    std::vector<ConnectionPtr> &connections = it->second;
+    connections.erase(std::remove_if(connections.begin(),
+                                     connections.end(),
+                                     [conn](const ConnectionPtr &c) { return c.get() == conn; }),
+                      connections.end());
+    if (connections.empty()) {
+        shard.sessions.erase(it);
+        return true;
+    }
+    return false;
+}
+
+std::vector<ConnectionPtr> PresenceRegistry::sessions(int userId) const
+{
+    const Shard &shard = shardFor(userId);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    auto it = shard.sessions.find(userId);
+    if (it == shard.sessions.end()) {
+        return {};
+    }
+    return it->second;
+}
+
+bool PresenceRegistry::isOnline(int userId) const
+{
+    const Shard &shard = shardFor(userId);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    return shard.sessions.find(userId) != shard.sessions.end();
+}
+
+PresenceNotifier::PresenceNotifier(PresenceRegistry &registry, FriendGraph &friends, int coalesceMs)
+    : m_registry(registry)
+    , m_friends(friends)
+    , m_window(coalesceMs)
+{
+    m_thread = std::thread(&PresenceNotifier::run, this);
+}
+
+PresenceNotifier::~PresenceNotifier()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_cond.notify_one();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void PresenceNotifier::notifyChanged(int userId)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // Đã có một lần kiểm tra đang chờ: lần đó sẽ đọc trạng thái mới nhất
+        if (!m_scheduled.insert(userId).second) {
+            return;
+        }
+        m_queue.push_back({userId, std::chrono::steady_clock::now() + m_window});
+    }
+    m_cond.notify_one();
+}
+
+void PresenceNotifier::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_cond.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+        if (m_stopping) {
+            break;
+        }
+        // Dừng sớm khi server tắt, các thay đổi còn lại không cần báo nữa
+        auto due = m_queue.front().due;
+        if (m_cond.wait_until(lock, due, [this] { return m_stopping; })) {
+            break;
+        }
+
+        int userId = m_queue.front().userId;
+        m_queue.pop_front();
+        m_scheduled.erase(userId);
+
+        lock.unlock();
+        bool online = m_registry.isOnline(userId);
+        bool wasOnline = m_publishedOnline.count(userId) != 0;
+        if (online != wasOnline) {
+            if (online) {
+                m_publishedOnline.insert(userId);
+            } else {
+                m_publishedOnline.erase(userId);
+            }
+            publish(userId, online);
+        }
+        lock.lock();
+    }
+}
+
+void PresenceNotifier::publish(int userId, bool online)
+{
+    // Serialize một lần cho mọi người nhận
+    QJsonObject event = {{"action", "presenceChanged"}, {"userID", userId}, {"status", online ? 1 : 0}};
+    EncodedMessage payload(event);
+
+    int delivered = 0;
+    for (int friendId : m_friends.friendsOf(userId)) {
+        delivered += Server::getInstance()->sendToUser(friendId, payload);
+    }
+    qDebug() << "Presence of user" << userId << (online ? "online" : "offline") << "pushed to" << delivered
+             << "sessions.";
+}
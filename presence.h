@@ -0,0 +1,93 @@
+#ifndef PRESENCE_H
+#define PRESENCE_H
+
+#include "connection.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class FriendGraph;
+
+#define PRESENCE_SHARDS 64
+
+// Trạng thái online của người dùng, chỉ giữ trong bộ nhớ (không ghi Users.Status).
+// Bảng băm chia thành PRESENCE_SHARDS phần theo UserID, mỗi phần có khóa riêng nên
+// login/disconnect của những người dùng khác nhau ít khi tranh chấp nhau.
+// Một người dùng có thể có nhiều phiên (nhiều thiết bị) cùng lúc. Chiều ngược lại
+// (kết nối -> người dùng) nằm ở Connection::userId nên disconnect không phải duyệt bảng.
+class PresenceRegistry
+{
+public:
+    // Trả về true nếu đây là phiên đầu tiên (người dùng vừa chuyển sang online)
+    bool addSession(int userId, const ConnectionPtr &conn);
+    // Trả về true nếu đó là phiên cuối cùng (người dùng vừa chuyển sang offline)
+    bool removeSession(int userId, const Connection *conn);
+
+    // Giao hàng qua chính đối tượng Connection nên không bao giờ ghi nhầm vào
+    // một số hiệu socket đã bị đóng và cấp lại cho kết nối khác
+    std::vector<ConnectionPtr> sessions(int userId) const;
+    bool isOnline(int userId) const;
+
+private:
+    struct Shard
+    {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<int, std::vector<ConnectionPtr>> sessions;
+    };
+
+    Shard &shardFor(int userId) { return m_shards[static_cast<unsigned>(userId) % PRESENCE_SHARDS]; }
+    const Shard &shardFor(int userId) const
+    {
+        return m_shards[static_cast<unsigned>(userId) % PRESENCE_SHARDS];
+    }
+
+    Shard m_shards[PRESENCE_SHARDS];
+};
+
+// Đẩy sự kiện "presenceChanged" tới các bạn bè đang online khi một người dùng
+// chuyển online/offline. Mỗi thay đổi chờ coalesceMs trên luồng riêng rồi mới
+// so trạng thái hiện tại với trạng thái đã báo lần trước: kết nối rồi ngắt
+// (hoặc ngắt rồi kết nối lại) trong cửa sổ đó chỉ sinh nhiều nhất một sự kiện.
+class PresenceNotifier
+{
+public:
+    PresenceNotifier(PresenceRegistry &registry, FriendGraph &friends, int coalesceMs);
+    ~PresenceNotifier();
+
+    PresenceNotifier(const PresenceNotifier &) = delete;
+    PresenceNotifier &operator=(const PresenceNotifier &) = delete;
+
+    // Gọi khi phiên đầu tiên được thêm hoặc phiên cuối cùng bị gỡ
+    void notifyChanged(int userId);
+
+private:
+    struct PendingChange
+    {
+        int userId;
+        std::chrono::steady_clock::time_point due;
+    };
+
+    void run();
+    void publish(int userId, bool online);
+
+    PresenceRegistry &m_registry;
+    FriendGraph &m_friends;
+    const std::chrono::milliseconds m_window;
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    // Cùng một cửa sổ nên hàng đợi luôn tăng dần theo due
+    std::deque<PendingChange> m_queue;
+    std::unordered_set<int> m_scheduled;
+    bool m_stopping = false;
+    // Người dùng đã được báo là online; chỉ luồng notifier đọc/ghi
+    std::unordered_set<int> m_publishedOnline;
+};
+
+#endif // PRESENCE_H
@@ -0,0 +1,123 @@
+#include "protocol.h"
+#include <QDebug>
+#include <algorithm>
+
+static bool isJsonWhitespace(unsigned char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+FrameDecoder::FrameDecoder(size_t maxFrameSize)
+    : m_maxFrameSize(std::min<size_t>(maxFrameSize, MAX_FRAME_PAYLOAD))
+{}
+
+bool FrameDecoder::extractFrames(std::vector<QByteArray> &frames)
+{
+    if (m_mode.load(std::memory_order_relaxed) == FrameMode::Unknown) {
+        // Bỏ khoảng trắng đầu luồng rồi quyết định kiểu khung từ byte đầu tiên
+        size_t skip = 0;
+        while (skip < m_buffer.size() && isJsonWhitespace(m_buffer.at(skip))) {
+            ++skip;
+        }
+        m_buffer.consume(skip);
+        if (m_buffer.empty()) {
+            return true;
+        }
+
+        unsigned char first = m_buffer.at(0);
+        if (first == '{') {
+            m_mode.store(FrameMode::LegacyJson, std::memory_order_release);
+            qDebug() << "Client uses legacy unframed JSON.";
+        } else if (first == 0) {
+            m_mode.store(FrameMode::LengthPrefixed, std::memory_order_release);
+        } else {
+            qDebug() << "Unknown framing, first byte:" << first;
+            return false;
+        }
+    }
+
+    if (m_mode.load(std::memory_order_relaxed) == FrameMode::LengthPrefixed) {
+        return extractLengthPrefixed(frames);
+    }
+    return extractLegacyJson(frames);
+}
+
+bool FrameDecoder::extractLengthPrefixed(std::vector<QByteArray> &frames)
+{
+    while (m_buffer.size() >= FRAME_HEADER_SIZE) {
+        size_t len = (size_t(m_buffer.at(0)) << 24) | (size_t(m_buffer.at(1)) << 16)
+                     | (size_t(m_buffer.at(2)) << 8) | size_t(m_buffer.at(3));
+        if (len > m_maxFrameSize) {
+            qDebug() << "Frame too large:" << len << "bytes";
+            return false;
+        }
+        if (m_buffer.size() < FRAME_HEADER_SIZE + len) {
+            break; // chờ phần còn lại của frame
+        }
+        frames.push_back(takeFrame(FRAME_HEADER_SIZE, len));
+    }
+    return true;
+}
+
+bool FrameDecoder::extractLegacyJson(std::vector<QByteArray> &frames)
+{
+    // Quét tiếp từ vị trí lần trước, đếm ngoặc nhọn ngoài chuỗi để tìm hết một object
+    while (m_scanOffset < m_buffer.size()) {
+        unsigned char c = m_buffer.at(m_scanOffset);
+
+        if (m_depth == 0) {
+            if (isJsonWhitespace(c)) {
+                m_buffer.consume(1);
+                continue;
+            }
+            if (c != '{') {
+                qDebug() << "Malformed legacy JSON stream.";
+                return false;
+            }
+        }
+
+        ++m_scanOffset;
+        if (m_inString) {
+            if (m_escape) {
+                m_escape = false;
+            } else if (c == '\\') {
+                m_escape = true;
+            } else if (c == '"') {
+                m_inString = false;
+            }
+        } else if (c == '"') {
+            m_inString = true;
+        } else if (c == '{') {
+            ++m_depth;
+        } else if (c == '}') {
+            if (--m_depth == 0) {
+                size_t len = m_scanOffset;
+                m_scanOffset = 0;
+                frames.push_back(takeFrame(0, len));
+            }
+        }
+
+        if (m_scanOffset > m_maxFrameSize) {
+            qDebug() << "Legacy JSON request too large.";
+            return false;
+        }
+    }
+    return true;
+}
+
+QByteArray FrameDecoder::takeFrame(size_t offset, size_t len)
+{
+    QByteArray frame;
+    frame.resize(static_cast<qsizetype>(len));
+    m_buffer.peek(offset, frame.data(), len);
+    m_buffer.consume(offset + len);
+    return frame;
+}
+
+void writeFrameHeader(char *out, size_t payloadLen)
+{
+    out[0] = static_cast<char>((payloadLen >> 24) & 0xFF);
+    out[1] = static_cast<char>((payloadLen >> 16) & 0xFF);
+    out[2] = static_cast<char>((payloadLen >> 8) & 0xFF);
+    out[3] = static_cast<char>(payloadLen & 0xFF);
+}
@@ -0,0 +1,54 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include "ringbuffer.h"
+#include <QByteArray>
+#include <atomic>
+#include <vector>
+
+// Khung tin trên đường truyền: 4 byte độ dài (big-endian) + JSON.
+// Vì độ dài tối đa nhỏ hơn 16 MB nên byte đầu tiên của một frame luôn là 0,
+// còn client cũ gửi JSON trần bắt đầu bằng '{' -> phân biệt được ngay từ byte đầu.
+#define FRAME_HEADER_SIZE 4
+#define MAX_FRAME_PAYLOAD 0x00FFFFFF
+
+enum class FrameMode {
+    Unknown,        // chưa nhận byte nào
+    LengthPrefixed, // 4 byte độ dài + payload
+    LegacyJson,     // client cũ: các object JSON nối tiếp nhau, không có header
+};
+
+// Ghép dữ liệu nhận được thành các frame hoàn chỉnh cho một kết nối.
+// Chỉ luồng đọc của kết nối được gọi extractFrames(); mode() đọc được từ mọi luồng.
+class FrameDecoder
+{
+public:
+    explicit FrameDecoder(size_t maxFrameSize);
+
+    RingBuffer &buffer() { return m_buffer; }
+    FrameMode mode() const { return m_mode.load(std::memory_order_acquire); }
+
+    // Lấy tất cả frame hoàn chỉnh đang có trong buffer.
+    // Trả về false nếu dữ liệu vi phạm giao thức (kết nối nên bị đóng).
+    bool extractFrames(std::vector<QByteArray> &frames);
+
+private:
+    bool extractLengthPrefixed(std::vector<QByteArray> &frames);
+    bool extractLegacyJson(std::vector<QByteArray> &frames);
+    QByteArray takeFrame(size_t offset, size_t len);
+
+    RingBuffer m_buffer;
+    std::atomic<FrameMode> m_mode{FrameMode::Unknown};
+    size_t m_maxFrameSize;
+
+    // Trạng thái quét JSON của client cũ, giữ lại giữa các lần đọc
+    size_t m_scanOffset = 0;
+    int m_depth = 0;
+    bool m_inString = false;
+    bool m_escape = false;
+};
+
+// Ghi FRAME_HEADER_SIZE byte độ dài của một payload gửi đi vào out
+void writeFrameHeader(char *out, size_t payloadLen);
+
+#endif // PROTOCOL_H
@@ -0,0 +1,164 @@
+#include "ratelimit.h"
+#include "config.h"
+#include <QDebug>
+#include <algorithm>
+#include <chrono>
+
+// Số ô dò tối đa khi tìm ô cho một UserID
+#define USER_SLOT_PROBES 8
+
+TokenBucket::Limit TokenBucket::makeLimit(double perSecond, int burst)
+{
+    Limit limit;
+    if (perSecond > 0) {
+        limit.intervalNs = std::max<int64_t>(1, static_cast<int64_t>(1e9 / perSecond));
+        limit.toleranceNs = limit.intervalNs * (std::max(1, burst) - 1);
+    }
+    return limit;
+}
+
+bool TokenBucket::tryConsume(const Limit &limit, int64_t nowNs)
+{
+    if (limit.intervalNs == 0) {
+        return true;
+    }
+    int64_t fullAt = m_fullAtNs.load(std::memory_order_relaxed);
+    while (true) {
+        // Bucket đã đầy từ trước thì tính từ hiện tại, token tích thêm không vượt burst
+        int64_t start = std::max(fullAt, nowNs);
+        if (start - nowNs > limit.toleranceNs) {
+            return false;
+        }
+        if (m_fullAtNs.compare_exchange_weak(fullAt, start + limit.intervalNs, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+}
+
+bool TokenBucket::conforms(const Limit &limit, int64_t nowNs) const
+{
+    if (limit.intervalNs == 0) {
+        return true;
+    }
+    return std::max(m_fullAtNs.load(std::memory_order_relaxed), nowNs) - nowNs <= limit.toleranceNs;
+}
+
+void TokenBucket::refund(const Limit &limit)
+{
+    m_fullAtNs.fetch_sub(limit.intervalNs, std::memory_order_relaxed);
+}
+
+RateLimiter::RateLimiter()
+{
+    const ServerConfig &config = serverConfig();
+    for (size_t i = 0; i < static_cast<size_t>(RateClass::Count); ++i) {
+        const RateLimitConfig &limit = config.rateLimits[i];
+        m_connectionLimits[i] = TokenBucket::makeLimit(limit.perSecond, limit.burst);
+        m_userLimits[i] = TokenBucket::makeLimit(limit.userPerSecond, limit.userBurst);
+    }
+
+    size_t slotCount = 1;
+    while (slotCount < static_cast<size_t>(config.rateLimitUserSlots)) {
+        slotCount <<= 1;
+    }
+    m_userSlots.reset(new UserSlot[slotCount]);
+    m_userSlotMask = slotCount - 1;
+}
+
+bool RateLimiter::UserSlot::idle(int64_t nowNs) const
+{
+    for (const TokenBucket &bucket : buckets.buckets) {
+        if (!bucket.idle(nowNs)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+RateBuckets *RateLimiter::userBuckets(int userId, int64_t nowNs)
+{
+    // UserID được cấp tăng dần nên lấy các bit thấp là đủ phân tán
+    const size_t home = static_cast<size_t>(userId) & m_userSlotMask;
+    const size_t probes = std::min<size_t>(USER_SLOT_PROBES, m_userSlotMask + 1);
+
+    // Lượt 1: ô của chính người dùng, hoặc ô trống đầu tiên
+    for (size_t i = 0; i < probes; ++i) {
+        UserSlot &slot = m_userSlots[(home + i) & m_userSlotMask];
+        int owner = slot.userId.load(std::memory_order_acquire);
+        // CAS thất bại nghĩa là luồng khác vừa chiếm ô trống, owner nhận chủ mới
+        if (owner == -1 && slot.userId.compare_exchange_strong(owner, userId, std::memory_order_acq_rel)) {
+            return &slot.buckets;
+        }
+        if (owner == userId) {
+            return &slot.buckets;
+        }
+    }
+    // Lượt 2: lấy lại ô của người dùng đã ngừng gửi. Bucket đã đầy lại tương đương bucket mới,
+    // nên chủ cũ không mất gì và không cần đặt lại
+    for (size_t i = 0; i < probes; ++i) {
+        UserSlot &slot = m_userSlots[(home + i) & m_userSlotMask];
+        int owner = slot.userId.load(std::memory_order_acquire);
+        if (owner == userId) {
+            return &slot.buckets;
+        }
+        if (slot.idle(nowNs) && slot.userId.compare_exchange_strong(owner, userId, std::memory_order_acq_rel)) {
+            return &slot.buckets;
+        }
+    }
+    m_userSlotMisses.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+}
+
+bool RateLimiter::allow(RateBuckets &connectionBuckets, int userId, RateClass rateClass)
+{
+    const size_t index = static_cast<size_t>(rateClass);
+    const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now().time_since_epoch())
+                            .count();
+
+    // Bucket theo kết nối chỉ được xem trước; bucket theo người dùng (dùng chung giữa các
+    // kết nối) được lấy bằng CAS, rồi mới lấy token của kết nối
+    TokenBucket &connectionBucket = connectionBuckets.buckets[index];
+    if (!connectionBucket.conforms(m_connectionLimits[index], now)) {
+        recordDrop(rateClass, PerConnection);
+        return false;
+    }
+    TokenBucket *userBucket = nullptr;
+    if (userId >= 0) {
+        // Không có ô (bảng đầy người đang hoạt động): chỉ còn giới hạn theo kết nối,
+        // thay vì dùng chung bucket của người khác
+        RateBuckets *buckets = userBuckets(userId, now);
+        if (buckets) {
+            userBucket = &buckets->buckets[index];
+            if (!userBucket->tryConsume(m_userLimits[index], now)) {
+                recordDrop(rateClass, PerUser);
+                return false;
+            }
+        }
+    }
+    if (!connectionBucket.tryConsume(m_connectionLimits[index], now)) {
+        // Request khác trên cùng kết nối vừa lấy token cuối
+        if (userBucket) {
+            userBucket->refund(m_userLimits[index]);
+        }
+        recordDrop(rateClass, PerConnection);
+        return false;
+    }
+    return true;
+}
+
+void RateLimiter::recordDrop(RateClass rateClass, Scope scope)
+{
+    m_dropped[static_cast<size_t>(rateClass)][scope].fetch_add(1, std::memory_order_relaxed);
+    uint64_t total = m_totalDropped.fetch_add(1, std::memory_order_relaxed) + 1;
+    // Chỉ ghi log thưa để chính việc ghi log không bị client flood
+    if (total == 1 || total % 1000 == 0) {
+        qDebug() << "Rate limit: dropped" << total << "requests, last in class" << rateClassName(rateClass)
+                 << (scope == PerUser ? "(per user)" : "(per connection)");
+    }
+}
+
+uint64_t RateLimiter::droppedCount(RateClass rateClass, Scope scope) const
+{
+    return m_dropped[static_cast<size_t>(rateClass)][scope].load(std::memory_order_relaxed);
+}
@@ -0,0 +1,91 @@
+#ifndef RATELIMIT_H
+#define RATELIMIT_H
+
+#include "opcode.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Token bucket lưu trong một số nguyên: thời điểm (ns) mà bucket sẽ đầy lại.
+// Lấy một token = đẩy mốc này thêm một khoảng interval; bị từ chối nếu mốc mới vượt
+// quá hiện tại hơn (burst - 1) interval. Cập nhật bằng một lần compare_exchange, không khóa.
+class TokenBucket
+{
+public:
+    struct Limit
+    {
+        // 0 = không giới hạn
+        int64_t intervalNs = 0;
+        int64_t toleranceNs = 0;
+    };
+
+    static Limit makeLimit(double perSecond, int burst);
+
+    bool tryConsume(const Limit &limit, int64_t nowNs);
+    // Như tryConsume nhưng không lấy token
+    bool conforms(const Limit &limit, int64_t nowNs) const;
+    // Trả lại token vừa lấy bằng tryConsume
+    void refund(const Limit &limit);
+    // Bucket đã đầy lại: không khác gì một bucket mới
+    bool idle(int64_t nowNs) const { return m_fullAtNs.load(std::memory_order_relaxed) <= nowNs; }
+
+private:
+    std::atomic<int64_t> m_fullAtNs{0};
+};
+
+// Một bucket cho mỗi RateClass, nhúng trong Connection
+struct RateBuckets
+{
+    TokenBucket buckets[static_cast<size_t>(RateClass::Count)];
+};
+
+// Kiểm tra giới hạn tốc độ trước khi dispatch request. Bucket theo kết nối nằm trong
+// Connection; bucket theo người dùng nằm trong một bảng băm cố định theo UserID
+// (dò tuyến tính USER_SLOT_PROBES ô), nên đường nóng chỉ gồm các thao tác atomic,
+// không có khóa hay cấp phát.
+class RateLimiter
+{
+public:
+    enum Scope { PerConnection, PerUser, ScopeCount };
+
+    RateLimiter();
+
+    RateLimiter(const RateLimiter &) = delete;
+    RateLimiter &operator=(const RateLimiter &) = delete;
+
+    // userId = -1 nếu kết nối chưa đăng nhập (chỉ áp dụng giới hạn theo kết nối).
+    // Chỉ lấy token khi cả hai bucket cùng cho phép: request bị bucket này chặn
+    // không làm hao token của bucket kia.
+    bool allow(RateBuckets &connectionBuckets, int userId, RateClass rateClass);
+
+    uint64_t droppedCount(RateClass rateClass, Scope scope) const;
+    uint64_t totalDropped() const { return m_totalDropped.load(std::memory_order_relaxed); }
+    // Số lần không tìm được ô cho người dùng (bảng đầy người đang hoạt động)
+    uint64_t userSlotMisses() const { return m_userSlotMisses.load(std::memory_order_relaxed); }
+
+private:
+    struct UserSlot
+    {
+        // Chủ của ô (-1 = trống). Chỉ đổi chủ khi mọi bucket đã đầy lại,
+        // nên người dùng khác không bao giờ dùng chung hay xóa bucket đang chạy
+        std::atomic<int> userId{-1};
+        RateBuckets buckets;
+
+        bool idle(int64_t nowNs) const;
+    };
+
+    // nullptr nếu mọi ô dò được đều thuộc người dùng khác đang hoạt động
+    RateBuckets *userBuckets(int userId, int64_t nowNs);
+    void recordDrop(RateClass rateClass, Scope scope);
+
+    TokenBucket::Limit m_connectionLimits[static_cast<size_t>(RateClass::Count)];
+    TokenBucket::Limit m_userLimits[static_cast<size_t>(RateClass::Count)];
+    std::unique_ptr<UserSlot[]> m_userSlots;
+    size_t m_userSlotMask = 0;
+    std::atomic<uint64_t> m_dropped[static_cast<size_t>(RateClass::Count)][ScopeCount] = {};
+    std::atomic<uint64_t> m_totalDropped{0};
+    std::atomic<uint64_t> m_userSlotMisses{0};
+};
+
+#endif // RATELIMIT_H
@@ -0,0 +1,92 @@
+#include "ringbuffer.h"
+#include <algorithm>
+#include <cstring>
+
+static size_t roundUpPowerOfTwo(size_t value)
+{
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+RingBuffer::RingBuffer(size_t initialCapacity)
+    : m_data(roundUpPowerOfTwo(std::max<size_t>(initialCapacity, 16)))
+    , m_initialCapacity(m_data.size())
+{}
+
+void RingBuffer::append(const char *data, size_t len)
+{
+    while (len > 0) {
+        size_t available = 0;
+        char *dest = prepareWrite(1, available);
+        size_t chunk = std::min(len, available);
+        memcpy(dest, data, chunk);
+        commitWrite(chunk);
+        data += chunk;
+        len -= chunk;
+    }
+}
+
+void RingBuffer::peek(size_t offset, char *out, size_t len) const
+{
+    size_t mask = m_data.size() - 1;
+    size_t start = (m_head + offset) & mask;
+    size_t first = std::min(len, m_data.size() - start);
+    memcpy(out, m_data.data() + start, first);
+    if (len > first) {
+        memcpy(out + first, m_data.data(), len - first);
+    }
+}
+
+void RingBuffer::consume(size_t len)
+{
+    len = std::min(len, m_size);
+    m_head = (m_head + len) & (m_data.size() - 1);
+    m_size -= len;
+    if (m_size == 0) {
+        m_head = 0;
+        // Trả lại bộ nhớ sau một request lớn để kết nối rảnh không giữ bộ đệm to
+        if (m_data.size() > m_initialCapacity * 16) {
+            std::vector<char>(m_initialCapacity).swap(m_data);
+        }
+    }
+}
+
+char *RingBuffer::prepareWrite(size_t minBytes, size_t &available)
+{
+    if (m_data.size() - m_size < minBytes) {
+        reserve(m_size + minBytes);
+    }
+
+    size_t mask = m_data.size() - 1;
+    size_t tail = (m_head + m_size) & mask;
+    if (tail >= m_head && !(m_size > 0 && tail == m_head)) {
+        // Vùng trống nằm ở cuối mảng (và có thể thêm phần đầu mảng)
+        available = m_data.size() - tail;
+        if (available < minBytes) {
+            // Phần liên tục ở cuối quá nhỏ: dồn dữ liệu về đầu mảng
+            reserve(m_data.size());
+            tail = m_size;
+            available = m_data.size() - tail;
+        }
+    } else {
+        available = m_head - tail;
+    }
+    return m_data.data() + tail;
+}
+
+void RingBuffer::commitWrite(size_t len)
+{
+    m_size += len;
+}
+
+void RingBuffer::reserve(size_t minCapacity)
+{
+    // Cấp phát lại và tuyến tính hóa dữ liệu về đầu mảng
+    std::vector<char> data(roundUpPowerOfTwo(std::max(minCapacity, m_data.size())));
+    peek(0, data.data(), m_size);
+    m_data.swap(data);
+    m_head = 0;
+}
@@ -0,0 +1,41 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <cstddef>
+#include <vector>
+
+// Bộ đệm vòng tự mở rộng (dung lượng luôn là lũy thừa của 2) cho dữ liệu nhận từ socket.
+// Không thread-safe: chỉ luồng đọc của kết nối được dùng nó.
+class RingBuffer
+{
+public:
+    explicit RingBuffer(size_t initialCapacity = 4096);
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    size_t capacity() const { return m_data.size(); }
+
+    void append(const char *data, size_t len);
+
+    // Byte thứ offset tính từ đầu dữ liệu chưa đọc
+    unsigned char at(size_t offset) const { return m_data[(m_head + offset) & (m_data.size() - 1)]; }
+    // Sao chép len byte bắt đầu từ offset ra out
+    void peek(size_t offset, char *out, size_t len) const;
+    // Bỏ len byte đầu đã xử lý xong
+    void consume(size_t len);
+
+    // Trả về vùng trống liên tục ở cuối (ít nhất minBytes) để recv() ghi thẳng vào,
+    // sau đó gọi commitWrite() với số byte thực sự đã ghi
+    char *prepareWrite(size_t minBytes, size_t &available);
+    void commitWrite(size_t len);
+
+private:
+    void reserve(size_t minCapacity);
+
+    std::vector<char> m_data;
+    size_t m_head = 0;
+    size_t m_size = 0;
+    size_t m_initialCapacity;
+};
+
+#endif // RINGBUFFER_H
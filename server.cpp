@@ -2,19 +2,34 @@
 #include <QDebug>
 #include <QDir>
 #include <QNetworkInterface>
-#include <QSqlDatabase>
 #include <QSqlError>
-#include <QSqlQuery>
 #include "authentication.h"
+#include "config.h"
+#include "database.h"
 #include "header.h"
 #include "friend.h"
+#include "group.h"
+#include "delivery.h"
+#include "migrations.h"
+#include <cstring>
+#ifndef _WIN32
+#include <sys/epoll.h>
+#endif
+
+#define RECV_CHUNK_SIZE 16384
+#define MAX_EPOLL_EVENTS 256
+#define MAX_REQUESTS_PER_TURN 16
 
 Server *Server::m_instance = nullptr;
 
+// Kết nối mà worker hiện tại đang xử lý request, để gửi phản hồi không phải tra registry
+static thread_local Connection *currentConnection = nullptr;
+
 Server::Server(QObject *parent)
     : QObject(parent)
     , serverSocket(INVALID_SOCKET)
     , m_serverPort(8080)
+    , connections(static_cast<size_t>(serverConfig().maxConnections))
 {
     if (m_instance) {
         qFatal("Server instance already exists! Only one instance is allowed.");
@@ -35,22 +50,54 @@ Server::Server(QObject *parent)
     }
 
     // Initialize handlers
+    buildActionTable();
     initAuthenticationHandlers(handlers);
     initFriendHandlers(handlers);
+    initGroupHandlers(handlers);
+    initDeliveryHandlers(handlers);
+    initHeartbeatHandlers(handlers);
 
     // Initialize Database
     initDatabase();
+    messageWriter = std::make_unique<MessageWriter>(DB_NAME);
+    friendGraph = std::make_unique<FriendGraph>();
+    if (!friendGraph->load(DB_NAME)) {
+        qFatal("Failed to load friendship graph from %s", DB_NAME);
+    }
+    sessionTokens = std::make_unique<SessionTokenStore>(std::chrono::minutes(serverConfig().sessionTokenTtlMinutes));
+    groupCache = std::make_unique<GroupCache>();
+    if (!groupCache->load(DB_NAME)) {
+        qFatal("Failed to load groups from %s", DB_NAME);
+    }
+    presenceNotifier = std::make_unique<PresenceNotifier>(presence, *friendGraph, serverConfig().presenceCoalesceMs);
+    heartbeat = std::make_unique<HeartbeatMonitor>(serverConfig().pingIntervalMs,
+                                                   serverConfig().idleTimeoutMs,
+                                                   serverConfig().heartbeatTickMs);
+
+    workerPool = std::make_unique<WorkerPool>("request", serverConfig().workerThreads);
+    authPool = std::make_unique<WorkerPool>("auth", serverConfig().authThreads, serverConfig().authMaxQueued);
 }
 
 Server::~Server()
 {
+    heartbeat.reset();
+    // Dừng các pool trước khi hủy bất cứ thứ gì chúng dùng (graph, cache, token, MessageWriter).
+    // Auth trước: việc auth kết thúc còn đưa connection về workerPool; việc trên workerPool
+    // chạy nốt sau đó thì submitAuthTask chỉ nhận về false.
+    authPool->shutdown();
+    workerPool->shutdown();
+    presenceNotifier.reset();
+    // Ghi nốt các tin nhắn còn trong hàng đợi trước khi thoát
+    messageWriter.reset();
     if (m_instance == this) {
         m_instance = nullptr;
     }
     if (serverSocket != INVALID_SOCKET) {
         closesocket(serverSocket);
     }
+#ifdef _WIN32
     WSACleanup();
+#endif
 }
 
 Server *Server::getInstance()
@@ -83,94 +130,94 @@ void Server::initDatabase()
         qFatal("Failed to open database: %s", qPrintable(db.lastError().text()));
     }
 
-    QStringList tables;
-    tables << "create table if not exists Users ("
-              "UserID INTEGER PRIMARY KEY AUTOINCREMENT,"
-              "Username TEXT not null unique,"
-              "PasswordHash TEXT not null,"
-              "Status INTEGER default 0,"
-              "CreatedAt DATETIME default CURRENT_TIMESTAMP"
-              ");"
-           << "create table if not exists Messages ("
-              "MessageID INTEGER PRIMARY KEY AUTOINCREMENT,"
-              "SenderID INTEGER not null,"
-              "ReceiverID INTEGER not null,"
-              "Content TEXT not null,"
-              "SentAt DATETIME default CURRENT_TIMESTAMP,"
-              "foreign key (SenderID) references Users(UserID),"
-              "foreign key (ReceiverID) references Users(UserID)"
-              ");"
-           << "create table if not exists Friendships ("
-              "UserID1 INTEGER not null,"
-              "UserID2 INTEGER not null,"
-            //   "RequesterID INTEGER not null,"
-              "Status INTEGER not null,"
-              "CreatedAt DATETIME default CURRENT_TIMESTAMP,"
-              "primary key (UserID1, UserID2),"
-              "foreign key (UserID1) references Users(UserID),"
-              "foreign key (UserID2) references Users(UserID)"
-            //   "foreign key (RequesterID) references Users(UserID)"
-              ");"
-           << "create table if not exists Groups ("
-              "GroupID INTEGER PRIMARY KEY AUTOINCREMENT,"
-              "GroupName TEXT not null,"
-              "CreatedAt DATETIME default CURRENT_TIMESTAMP"
-              ");"
-           << "create table if not exists GroupMembers ("
-              "GroupID INTEGER not null,"
-              "UserID INTEGER not null,"
-              "JoinedAt DATETIME default CURRENT_TIMESTAMP,"
-              "primary key (GroupID, UserID),"
-              "foreign key (GroupID) references Groups(GroupID),"
-              "foreign key (UserID) references Users(UserID)"
-              ");"
-           << "create table if not exists GroupMessages ("
-              "GroupMessageID INTEGER PRIMARY KEY AUTOINCREMENT,"
-              "GroupID INTEGER not null,"
-              "SenderID INTEGER not null,"
-              "Content TEXT not null,"
-              "SentAt DATETIME default CURRENT_TIMESTAMP,"
-              "foreign key (GroupID) references Groups(GroupID),"
-              "foreign key (SenderID) references Users(UserID)"
-              ");";
-
-    QSqlQuery query(db);
-    for (const QString &table : tables) {
-        if (!query.exec(table)) {
-            qDebug() << "Failed to create table:" << query.lastError().text();
-        }
+    // Bật WAL trước khi migrate để các bước migrate cũng chạy trên WAL
+    configureConnection(db);
+    if (!migrateDatabase(db)) {
+        qFatal("Failed to migrate database %s", DB_NAME);
     }
 
     db.close();
+    db = QSqlDatabase();
     QSqlDatabase::removeDatabase("InitConnection");
     qDebug() << "Database initialized successfully.";
 }
 
 
-void Server::addUserToMap(int userId, SOCKET clientSock)
+bool Server::addUserToMap(int userId, SOCKET clientSock)
 {
-    userSocketsMutex.lock();
-    userSockets[userId] = clientSock;
-    qDebug() << "User" << userId << "added to userSockets map.";
-    userSocketsMutex.unlock();
+    ConnectionPtr conn = findConnection(clientSock);
+    if (!conn) {
+        return false;
+    }
+    return addUserToMap(userId, conn);
+}
+
+bool Server::addUserToMap(int userId, const ConnectionPtr &conn)
+{
+    std::lock_guard<std::mutex> lock(conn->sessionMutex);
+    if (conn->closing) {
+        // removeConnection đã (hoặc sắp) gỡ phiên của kết nối này, không gán thêm
+        return false;
+    }
+    if (conn->userId == userId) {
+        return true;
+    }
+    if (conn->userId != -1) {
+        // Đăng nhập tài khoản khác trên cùng kết nối
+        presence.removeSession(conn->userId, conn.get());
+    }
+    conn->userId = userId;
+    if (presence.addSession(userId, conn)) {
+        qDebug() << "User" << userId << "is now online.";
+        presenceNotifier->notifyChanged(userId);
+    }
+    qDebug() << "User" << userId << "added session on socket" << conn->socket;
+    return true;
+}
+
+bool Server::removeUserSession(int userId, SOCKET clientSock)
+{
+    ConnectionPtr conn = findConnection(clientSock);
+    if (!conn) {
+        return false;
+    }
+    return unbindUser(*conn, userId);
+}
+
+bool Server::unbindUser(Connection &conn, int expectedUserId)
+{
+    std::lock_guard<std::mutex> lock(conn.sessionMutex);
+    if (conn.userId == -1 || (expectedUserId != -1 && conn.userId != expectedUserId)) {
+        return false;
+    }
+    int userId = conn.userId;
+    conn.userId = -1;
+    if (presence.removeSession(userId, &conn)) {
+        qDebug() << "User" << userId << "is now offline.";
+        presenceNotifier->notifyChanged(userId);
+    }
+    return true;
 }
 
 void Server::runServer()
 {
-    WSADATA wsaData;
     int iResult;
 
+#ifdef _WIN32
+    WSADATA wsaData;
+
     // Khởi tạo Winsock
     iResult = WSAStartup(MAKEWORD(2, 2), &wsaData);
     if (iResult != 0) {
         qDebug() << "WSAStartup failed with error: " << iResult;
         return;
     }
+#endif
 
     struct addrinfo *result = NULL;
     struct addrinfo hints;
 
-    ZeroMemory(&hints, sizeof(hints));
+    memset(&hints, 0, sizeof(hints));
     hints.ai_family = AF_INET;       // IPv4
     hints.ai_socktype = SOCK_STREAM; // TCP stream
     hints.ai_protocol = IPPROTO_TCP; // TCP protocol
@@ -180,26 +227,39 @@ void Server::runServer()
     iResult = getaddrinfo(NULL, "8080", &hints, &result);
     if (iResult != 0) {
         qDebug() << "getaddrinfo failed with error: " << iResult;
+#ifdef _WIN32
         WSACleanup();
+#endif
         return;
     }
 
     // 1. Giai đoạn tạo socket (Create a SOCKET for connecting to server)
     serverSocket = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
     if (serverSocket == INVALID_SOCKET) {
-        qDebug() << "socket failed with error: " << WSAGetLastError();
+        qDebug() << "socket failed with error: " << lastSocketError();
         freeaddrinfo(result);
+#ifdef _WIN32
         WSACleanup();
+#endif
         return;
     }
 
+#ifndef _WIN32
+    // Cho phép khởi động lại server ngay mà không chờ TIME_WAIT
+    int reuse = 1;
+    setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+#endif
+
     // 2. Giai đoạn bind (Setup the TCP listening socket)
     iResult = bind(serverSocket, result->ai_addr, (int) result->ai_addrlen);
     if (iResult == SOCKET_ERROR) {
-        qDebug() << "bind failed with error: " << WSAGetLastError();
+        qDebug() << "bind failed with error: " << lastSocketError();
         freeaddrinfo(result);
         closesocket(serverSocket);
+        serverSocket = INVALID_SOCKET;
+#ifdef _WIN32
         WSACleanup();
+#endif
         return;
     }
 
@@ -208,126 +268,545 @@ void Server::runServer()
     // 3. Giai đoạn listen
     iResult = listen(serverSocket, SOMAXCONN);
     if (iResult == SOCKET_ERROR) {
-        qDebug() << "listen failed with error: " << WSAGetLastError();
+        qDebug() << "listen failed with error: " << lastSocketError();
         closesocket(serverSocket);
+        serverSocket = INVALID_SOCKET;
+#ifdef _WIN32
         WSACleanup();
+#endif
         return;
     }
 
     qDebug() << "Server listening on port 8080...";
 
+#ifdef _WIN32
     SOCKET clientSocket = INVALID_SOCKET;
 
     // 4. Giai đoạn accept (Accept a client socket)
-    // Vòng lặp để chấp nhận nhiều kết nối (tuần tự trong ví dụ đơn giản này)
+    // Winsock không có epoll: mỗi kết nối có một luồng đọc, request vẫn được xử lý trên worker pool
     while (true) {
-        clientSocket = accept(serverSocket, NULL, NULL);
+        struct sockaddr_in clientAddr;
+        socklen_t addrLen = sizeof(clientAddr);
+        clientSocket = accept(serverSocket, (struct sockaddr *) &clientAddr, &addrLen);
         if (clientSocket == INVALID_SOCKET) {
-            int error = WSAGetLastError();
+            int error = lastSocketError();
             if (error == WSAEINTR || error == WSAENOTSOCK) {
                 qDebug() << "Server stopped listening.";
                 return;
             }
             qDebug() << "accept failed with error: " << error;
             closesocket(serverSocket);
+            serverSocket = INVALID_SOCKET;
             WSACleanup();
             return;
         }
-        clientSocketsMutex.lock();
-        clientSockets.push_back(clientSocket);
-        clientSocketsMutex.unlock();
-        qDebug() << "Client connected!";
+        ConnectionPtr conn = registerConnection(clientSocket, inet_ntoa(clientAddr.sin_addr));
+        if (!conn) {
+            continue;
+        }
 
         // Handle client in a separate thread
-        std::thread(&Server::handleClient, this, clientSocket).detach();
+        std::thread(&Server::handleClient, this, conn).detach();
+    }
+#else
+    // 4. Giai đoạn accept: mỗi reactor có một epoll riêng và cùng chờ trên socket lắng nghe
+    // (EPOLLEXCLUSIVE chỉ đánh thức một reactor cho mỗi kết nối mới).
+    if (!setNonBlocking(serverSocket)) {
+        qDebug() << "Failed to make listening socket non-blocking: " << lastSocketError();
+        closesocket(serverSocket);
+        serverSocket = INVALID_SOCKET;
+        return;
+    }
+
+    std::vector<int> epollFds;
+    for (int i = 0; i < serverConfig().reactorThreads; ++i) {
+        int epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (epollFd == -1) {
+            qDebug() << "epoll_create1 failed with error: " << lastSocketError();
+            break;
+        }
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+        ev.data.ptr = nullptr; // nullptr đánh dấu socket lắng nghe
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, serverSocket, &ev) == -1) {
+            qDebug() << "epoll_ctl failed with error: " << lastSocketError();
+            close(epollFd);
+            break;
+        }
+        epollFds.push_back(epollFd);
+    }
+    if (epollFds.empty()) {
+        closesocket(serverSocket);
+        serverSocket = INVALID_SOCKET;
+        return;
+    }
+
+    for (size_t i = 1; i < epollFds.size(); ++i) {
+        std::thread(&Server::reactorLoop, this, epollFds[i]).detach();
+    }
+    reactorLoop(epollFds[0]);
+#endif
+}
+
+void Server::logRejectedConnection(const std::string &clientIp)
+{
+    // Ghi log thưa để đợt dồn kết nối không làm đầy log
+    uint64_t rejected = connections.rejectedCount();
+    if (rejected == 1 || rejected % 1000 == 0) {
+        qDebug() << "Connection limit" << connections.capacity() << "reached, rejected" << rejected
+                 << "connections so far (last from" << QString::fromStdString(clientIp) << ")";
     }
 }
 
-void Server::handleClient(SOCKET clientSocket)
+ConnectionPtr Server::registerConnection(SOCKET clientSocket, const std::string &clientIp)
 {
-    struct sockaddr_in clientAddr;
-    int addrLen = sizeof(clientAddr);
-    getpeername(clientSocket, (struct sockaddr*)&clientAddr, &addrLen);
-    std::string clientIp = inet_ntoa(clientAddr.sin_addr);
+    // Từ chối trước khi cấp phát Connection để khi bị dồn kết nối không tốn bộ nhớ
+    if (connections.full()) {
+        // Client chưa gửi byte nào nên chưa biết kiểu đóng khung: không có frame nào
+        // đọc được với cả hai kiểu, nên chỉ đóng kết nối mà không gửi gì
+        connections.recordRejected();
+        closesocket(clientSocket);
+        logRejectedConnection(clientIp);
+        return nullptr;
+    }
+    ConnectionPtr conn = std::make_shared<Connection>(clientSocket, clientIp);
+    if (!connections.insert(conn)) {
+        // Bảng vừa đầy trong lúc tạo Connection; socket được đóng khi conn bị hủy
+        logRejectedConnection(clientIp);
+        return nullptr;
+    }
+    heartbeat->watch(conn);
+    qDebug() << "Client connected," << connections.activeCount() << "connections open.";
+    return conn;
+}
 
+#ifdef _WIN32
+void Server::handleClient(ConnectionPtr conn)
+{
     int iResult;
-    char recvbuf[8192]; // Buffer lớn hơn để chứa JSON
-    int recvbuflen = 8192;
+    std::vector<QByteArray> frames;
 
     // Nhận dữ liệu từ client
     do {
-        iResult = recv(clientSocket, recvbuf, recvbuflen, 0);
+        size_t available = 0;
+        char *recvbuf = conn->decoder.buffer().prepareWrite(RECV_CHUNK_SIZE, available);
+        iResult = recv(conn->socket, recvbuf, static_cast<int>(available), 0);
         if (iResult > 0) {
             qDebug() << "Bytes received: " << iResult;
-
-            // Chuyển dữ liệu nhận được thành chuỗi (giả sử là JSON string)
-            std::string receivedData(recvbuf, iResult);
-            logMessage("[" + clientIp + "] " + receivedData);
-
-            // ---------------------------------------------------------
-            // [CHO TRONG DE XU LY THONG TIN DUOC GUI DEN]
-            // Tại đây bạn có thể parse chuỗi JSON 'receivedData'
-            // Ví dụ: auto jsonDoc = QJsonDocument::fromJson(QByteArray::fromStdString(receivedData));
-
-            clientSocketsMutex.lock();
-            try {
-                QJsonObject request
-                    = QJsonDocument::fromJson(QByteArray::fromStdString(receivedData)).object();
-                QString action = request["action"].toString();
-
-                if (handlers.find(action) != handlers.end()) {
-                    QJsonObject response = handlers[action](request, clientSocket);
-                } else {
-                    qDebug() << "Unknown action:" << action;
-                }
-            } catch (const std::exception &e) {
-                qDebug() << "Exception in handleClient:" << e.what();
-            } catch (...) {
-                qDebug() << "Unknown exception in handleClient";
+            conn->lastActivityMs.store(monotonicMs(), std::memory_order_relaxed);
+            conn->decoder.buffer().commitWrite(iResult);
+            if (!conn->decoder.extractFrames(frames)) {
+                break;
             }
-            clientSocketsMutex.unlock();
-
-            // ---------------------------------------------------------
-
+            queueRequests(conn, frames);
         } else if (iResult == 0)
             qDebug() << "Connection closing...";
         else {
-            qDebug() << "recv failed with error: " << WSAGetLastError();
+            qDebug() << "recv failed with error: " << lastSocketError();
             break;
         }
 
     } while (iResult > 0);
-    // logout user if logged in
-    userSocketsMutex.lock();
-    for (auto it = userSockets.begin(); it != userSockets.end(); ++it) {
-        if (it->second == clientSocket) {
-            int userId = it->first;
-            logoutUser(userId, DB_NAME);
-            userSockets.erase(it);
-            qDebug() << "User" << userId << "logged out and removed from userSockets map.";
-            break;
+
+    if (!deferCloseUntilDrained(*conn)) {
+        removeConnection(conn);
+    }
+}
+#else
+void Server::reactorLoop(int epollFd)
+{
+    std::vector<struct epoll_event> events(MAX_EPOLL_EVENTS);
+
+    while (true) {
+        int count = epoll_wait(epollFd, events.data(), MAX_EPOLL_EVENTS, -1);
+        if (count == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            qDebug() << "epoll_wait failed with error: " << lastSocketError();
+            return;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            Connection *conn = static_cast<Connection *>(events[i].data.ptr);
+            if (conn == nullptr) {
+                acceptConnections(epollFd);
+                continue;
+            }
+
+            uint32_t flags = events[i].events;
+            if (flags & EPOLLOUT) {
+                conn->onWritable();
+            }
+
+            // EPOLLHUP/EPOLLERR cũng được phát hiện qua recv trả về 0 hoặc lỗi
+            if ((flags & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) && !readFromConnection(*conn)
+                && !deferCloseUntilDrained(*conn)) {
+                epoll_ctl(epollFd, EPOLL_CTL_DEL, conn->socket, nullptr);
+                removeConnection(conn->shared_from_this());
+            }
         }
     }
-    userSocketsMutex.unlock();
-    // shutdown the connection since we're done
-    iResult = shutdown(clientSocket, SD_SEND);
-    if (iResult == SOCKET_ERROR) {
-        qDebug() << "shutdown failed with error: " << WSAGetLastError();
-        closesocket(clientSocket);
+}
+
+void Server::acceptConnections(int epollFd)
+{
+    while (true) {
+        struct sockaddr_in clientAddr;
+        socklen_t addrLen = sizeof(clientAddr);
+        SOCKET clientSocket = accept4(serverSocket,
+                                      (struct sockaddr *) &clientAddr,
+                                      &addrLen,
+                                      SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (clientSocket == INVALID_SOCKET) {
+            int error = lastSocketError();
+            if (socketWouldBlock(error) || error == EINTR || error == ECONNABORTED) {
+                return;
+            }
+            qDebug() << "accept failed with error: " << error;
+            return;
+        }
+
+        int noDelay = 1;
+        setsockopt(clientSocket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+        char ipBuffer[INET_ADDRSTRLEN] = {0};
+        inet_ntop(AF_INET, &clientAddr.sin_addr, ipBuffer, sizeof(ipBuffer));
+        ConnectionPtr conn = registerConnection(clientSocket, ipBuffer);
+        if (!conn) {
+            // Vẫn nhận tiếp để đóng ngay các kết nối đang chờ thay vì để chúng treo trong backlog
+            continue;
+        }
+        conn->epollFd = epollFd;
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+        ev.data.ptr = conn.get();
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, clientSocket, &ev) == -1) {
+            qDebug() << "epoll_ctl failed with error: " << lastSocketError();
+            removeConnection(conn);
+        }
+    }
+}
+
+bool Server::readFromConnection(Connection &conn)
+{
+    // Các frame của mọi lần đọc trong một sự kiện được đưa lên worker cùng một lượt
+    std::vector<QByteArray> frames;
+    RingBuffer &buffer = conn.decoder.buffer();
+
+    // Edge-triggered: phải đọc cho đến khi socket báo EAGAIN
+    while (true) {
+        size_t available = 0;
+        char *recvbuf = buffer.prepareWrite(RECV_CHUNK_SIZE, available);
+        int iResult = recv(conn.socket, recvbuf, static_cast<int>(available), 0);
+        if (iResult > 0) {
+            buffer.commitWrite(iResult);
+            if (!conn.decoder.extractFrames(frames)) {
+                // Các frame hợp lệ trước chỗ lỗi vẫn được xử lý
+                queueRequests(conn.shared_from_this(), frames);
+                return false;
+            }
+            continue;
+        }
+        if (iResult == 0) {
+            // Client gửi request cuối rồi đóng chiều ghi: request đó không được mất
+            qDebug() << "Connection closing...";
+            queueRequests(conn.shared_from_this(), frames);
+            return false;
+        }
+        int error = lastSocketError();
+        if (socketWouldBlock(error)) {
+            // Một lần store cho cả sự kiện; timer của kết nối tự hẹn lại theo mốc này
+            conn.lastActivityMs.store(monotonicMs(), std::memory_order_relaxed);
+            queueRequests(conn.shared_from_this(), frames);
+            return true;
+        }
+        if (error == EINTR) {
+            continue;
+        }
+        qDebug() << "recv failed with error: " << error;
+        queueRequests(conn.shared_from_this(), frames);
+        return false;
+    }
+}
+#endif
+
+MessageWriter &Server::getMessageWriter()
+{
+    return *messageWriter;
+}
+
+FriendGraph &Server::getFriendGraph()
+{
+    return *friendGraph;
+}
+
+GroupCache &Server::getGroupCache()
+{
+    return *groupCache;
+}
+
+SessionTokenStore &Server::getSessionTokens()
+{
+    return *sessionTokens;
+}
+
+const RateLimiter &Server::getRateLimiter() const
+{
+    return rateLimiter;
+}
+
+const ConnectionTable &Server::getConnectionTable() const
+{
+    return connections;
+}
+
+ConnectionPtr Server::findConnection(SOCKET clientSocket)
+{
+    if (currentConnection && currentConnection->socket == clientSocket) {
+        return currentConnection->shared_from_this();
+    }
+
+    return connections.find(clientSocket);
+}
+
+void Server::removeConnection(const ConnectionPtr &conn)
+{
+    conn->close();
+    if (connections.remove(*conn)) {
+        qDebug() << "Client disconnected," << connections.activeCount() << "connections open.";
+    }
+
+    // logout user if logged in: kết nối tự biết userId nên không phải duyệt presence
+    unbindUser(*conn);
+    // Socket được đóng khi worker cuối cùng trả lại tham chiếu tới Connection
+}
+
+void Server::queueRequests(const ConnectionPtr &conn, std::vector<QByteArray> &frames)
+{
+    if (frames.empty()) {
+        return;
+    }
+
+    bool schedule = false;
+    conn->requestMutex.lock();
+    for (QByteArray &frame : frames) {
+        conn->pendingRequests.push_back(std::move(frame));
+    }
+    if (!conn->scheduled) {
+        conn->scheduled = true;
+        schedule = true;
+    }
+    conn->requestMutex.unlock();
+    frames.clear();
+
+    if (schedule) {
+        workerPool->submit([this, conn] { processRequests(conn); });
+    }
+}
+
+void Server::processRequests(ConnectionPtr conn)
+{
+    // Xử lý tối đa MAX_REQUESTS_PER_TURN request rồi nhường worker cho kết nối khác
+    for (int handled = 0; handled < MAX_REQUESTS_PER_TURN; ++handled) {
+        QByteArray data;
+        conn->requestMutex.lock();
+        if (conn->pendingRequests.empty() || conn->closing) {
+            conn->pendingRequests.clear();
+            conn->scheduled = false;
+            bool drained = conn->closeWhenDrained;
+            conn->closeWhenDrained = false;
+            conn->requestMutex.unlock();
+            if (drained) {
+#ifdef _WIN32
+                removeConnection(conn);
+#else
+                // Reactor nhận hangup rồi dọn dẹp trên luồng của nó như mọi lần ngắt kết nối
+                conn->close();
+#endif
+            }
+            return;
+        }
+        data = std::move(conn->pendingRequests.front());
+        conn->pendingRequests.pop_front();
+        conn->requestMutex.unlock();
+
+        currentConnection = conn.get();
+        dispatchRequest(*conn, data);
+        currentConnection = nullptr;
+
+        // Giữ scheduled = true để queueRequests không lên lịch thêm; resumeRequests sẽ tiếp tục
+        std::lock_guard<std::mutex> lock(conn->requestMutex);
+        if (conn->parked) {
+            conn->parkedIdle = true;
+            return;
+        }
+    }
+    workerPool->submit([this, conn] { processRequests(conn); });
+}
+
+bool Server::deferCloseUntilDrained(Connection &conn)
+{
+    std::lock_guard<std::mutex> lock(conn.requestMutex);
+    if (!conn.scheduled || conn.closing) {
+        return false;
+    }
+    conn.closeWhenDrained = true;
+    return true;
+}
+
+void Server::parkRequests(Connection &conn)
+{
+    std::lock_guard<std::mutex> lock(conn.requestMutex);
+    conn.parked = true;
+}
+
+void Server::resumeRequests(const ConnectionPtr &conn)
+{
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(conn->requestMutex);
+        conn->parked = false;
+        // Lượt xử lý chưa kịp dừng (việc xong rất nhanh) thì nó tự chạy tiếp
+        wake = conn->parkedIdle;
+        conn->parkedIdle = false;
+    }
+    if (wake) {
+        workerPool->submit([this, conn] { processRequests(conn); });
+    }
+}
+
+// Frame từ chối dựng sẵn cho mỗi opcode và kiểu mã hóa, request vượt giới hạn
+// chỉ tốn một lần đưa QByteArray dùng chung vào hàng đợi gửi
+static const QByteArray &rateLimitedFrame(Opcode opcode, WireEncoding encoding)
+{
+    static const std::vector<QByteArray> frames = [] {
+        std::vector<QByteArray> result;
+        for (size_t op = 0; op < static_cast<size_t>(Opcode::Count); ++op) {
+            QJsonObject response = {{"action", "rateLimited"},
+                                    {"request", actionName(static_cast<Opcode>(op))},
+                                    {"success", false},
+                                    {"message", "Too many requests, please slow down."}};
+            result.push_back(encodeMessage(response, WireEncoding::Json));
+            result.push_back(encodeMessage(response, WireEncoding::Cbor));
+        }
+        return result;
+    }();
+    return frames[static_cast<size_t>(opcode) * 2 + (encoding == WireEncoding::Cbor ? 1 : 0)];
+}
+
+// Các trường bí mật không bao giờ được ghi xuống log
+static const char *const SECRET_FIELDS[] = {"password", "sessionToken"};
+
+static void logRequest(const Connection &conn, const Request &request, const QByteArray &data)
+{
+    // Payload CBOR chỉ ghi action và kích thước
+    if (request.encoding() != WireEncoding::Json) {
+        logMessage("[" + conn.peerIp + "] " + actionName(request.opcode()) + " <cbor "
+                   + std::to_string(data.size()) + " bytes>");
+        return;
+    }
+    // Payload JSON được ghi nguyên văn, trừ khi có trường bí mật: khi đó che giá trị rồi serialize lại
+    bool hasSecret = false;
+    for (const char *field : SECRET_FIELDS) {
+        hasSecret = hasSecret || request.contains(field);
+    }
+    if (!hasSecret) {
+        logMessage("[" + conn.peerIp + "] " + data.toStdString());
         return;
     }
+    QJsonObject redacted = request.toJsonObject();
+    for (const char *field : SECRET_FIELDS) {
+        if (redacted.contains(QLatin1String(field))) {
+            redacted[QLatin1String(field)] = "***";
+        }
+    }
+    logMessage("[" + conn.peerIp + "] " + QJsonDocument(redacted).toJson(QJsonDocument::Compact).toStdString());
+}
 
-    closesocket(clientSocket);
+void Server::dispatchRequest(Connection &conn, const QByteArray &data)
+{
+    // Không còn khóa toàn cục: các handler chạy song song, chỉ presence và
+    // bảng kết nối được bảo vệ bằng khóa riêng của chúng
+    try {
+        // Kiểm tra giới hạn trước khi giải mã, ghi log và gọi handler để client flood không
+        // làm chậm người khác; chỉ đọc trường action, request bị chặn nhận frame từ chối dựng sẵn
+        const Opcode opcode = peekOpcode(data);
+        const RateClass rateClass = rateClassOf(opcode);
+        if (!rateLimiter.allow(conn.rateBuckets, conn.userId.load(std::memory_order_relaxed), rateClass)) {
+            conn.sendFrame(rateLimitedFrame(opcode, WireEncoding::Json), rateLimitedFrame(opcode, WireEncoding::Cbor));
+            return;
+        }
+        Request request;
+        // Action đọc nhanh phải khớp nhóm của action thật (ví dụ không bị một khóa "action"
+        // lồng bên trong che mất), nếu không request đã được tính vào nhóm khác
+        if (!decodeRequest(data, request) || rateClassOf(request.opcode()) != rateClass) {
+            // Không ghi nội dung: request hỏng vẫn có thể chứa mật khẩu
+            logMessage("[" + conn.peerIp + "] <malformed " + std::to_string(data.size()) + " bytes>");
+            qDebug() << "Malformed request from" << QString::fromStdString(conn.peerIp);
+            return;
+        }
+        logRequest(conn, request, data);
+
+        // Action đã được đổi sang opcode lúc giải mã, tra handler chỉ là truy cập mảng
+        RequestHandler handler = handlers.find(request.opcode());
+        if (handler) {
+            handler(request, conn.socket);
+        } else {
+            qDebug() << "Unknown action:" << request.action();
+        }
+    } catch (const std::exception &e) {
+        qDebug() << "Exception in dispatchRequest:" << e.what();
+    } catch (...) {
+        qDebug() << "Unknown exception in dispatchRequest";
+    }
+}
+
+std::vector<ConnectionPtr> Server::getUserConnections(int userId)
+{
+    return presence.sessions(userId);
+}
+
+int Server::sendToUser(int userId, const QJsonObject &message)
+{
+    if (!presence.isOnline(userId)) {
+        return 0;
+    }
+    EncodedMessage encoded(message);
+    return sendToUser(userId, encoded);
+}
+
+int Server::sendToUser(int userId, EncodedMessage &message)
+{
+    std::vector<ConnectionPtr> connections = presence.sessions(userId);
+    int delivered = 0;
+    for (const ConnectionPtr &conn : connections) {
+        if (conn->sendMessage(message)) {
+            ++delivered;
+        }
+    }
+    return delivered;
 }
 
-SOCKET Server::getUserSocket(int userId)
+bool Server::isUserOnline(int userId)
 {
-    userSocketsMutex.lock();
-    if (userSockets.find(userId) != userSockets.end()) {
-        SOCKET sock = userSockets[userId];
-        userSocketsMutex.unlock();
-        return sock;
+    return presence.isOnline(userId);
+}
+
+bool Server::submitAuthTask(std::function<void()> task)
+{
+    if (authPool->trySubmit(std::move(task))) {
+        return true;
     }
-    userSocketsMutex.unlock();
-    return 0; // Return 0 if user not found
+    qDebug() << "Auth pool full (" << authPool->queueDepth() << "queued," << authPool->rejectedCount()
+             << "rejected so far), rejecting request.";
+    return false;
+}
+
+size_t Server::authQueueDepth() const
+{
+    return authPool->queueDepth();
 }
\ No newline at end of file
@@ -4,22 +4,32 @@
 #include <QObject>
 #include <QQmlEngine>
 #include "authentication.h"
+#include "connection.h"
+#include "connectiontable.h"
+#include "friendgraph.h"
+#include "groupcache.h"
+#include "handlertable.h"
+#include "heartbeat.h"
+#include "messagewriter.h"
+#include "platform.h"
+#include "presence.h"
+#include "ratelimit.h"
+#include "sessiontoken.h"
+#include "workerpool.h"
 #include <functional>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <shared_mutex>
 #include <thread>
 #include <vector>
-#include <winsock2.h>
-#include <ws2tcpip.h>
 
 #include <QJsonObject>
 #include <QJsonDocument>
 
 #define DB_NAME "ChatApp.db"
 
-#pragma comment(lib, "Ws2_32.lib")
-
 // Helper function to send JSON response
 
 
@@ -41,26 +51,78 @@ public:
     QString serverIp() const;
     int serverPort() const;
 
-    void addUserToMap(int userId, SOCKET clientSock);
-    SOCKET getUserSocket(int userId);
+    bool addUserToMap(int userId, SOCKET clientSock);
+    bool addUserToMap(int userId, const ConnectionPtr &conn);
+    bool removeUserSession(int userId, SOCKET clientSock);
+    std::vector<ConnectionPtr> getUserConnections(int userId);
+    // Serialize một lần rồi gửi tới mọi phiên của người dùng, trả về số phiên đã nhận
+    int sendToUser(int userId, const QJsonObject &message);
+    // Dùng khi fan-out tới nhiều người dùng: message chỉ được serialize một lần cho mỗi kiểu mã hóa
+    int sendToUser(int userId, EncodedMessage &message);
+    bool isUserOnline(int userId);
+    // Đưa việc băm/kiểm tra mật khẩu lên auth pool; false khi hàng đợi đã đầy
+    bool submitAuthTask(std::function<void()> task);
+    // Gọi từ handler trước khi giao việc bất đồng bộ: các request sau của kết nối chỉ được
+    // xử lý khi việc đó gọi resumeRequests, nên thứ tự request của kết nối được giữ nguyên
+    void parkRequests(Connection &conn);
+    void resumeRequests(const ConnectionPtr &conn);
+    size_t authQueueDepth() const;
+    ConnectionPtr findConnection(SOCKET clientSocket);
+    MessageWriter &getMessageWriter();
+    FriendGraph &getFriendGraph();
+    GroupCache &getGroupCache();
+    SessionTokenStore &getSessionTokens();
+    // Bộ đếm request bị chặn theo nhóm action
+    const RateLimiter &getRateLimiter() const;
+    // Số kết nối đang mở, đã nhận, bị từ chối vì đầy
+    const ConnectionTable &getConnectionTable() const;
 signals:
     void serverIpChanged();
     void serverPortChanged();
 
 private:
     void runServer();
-    void handleClient(SOCKET clientSocket);
+#ifdef _WIN32
+    void handleClient(ConnectionPtr conn);
+#else
+    void reactorLoop(int epollFd);
+    void acceptConnections(int epollFd);
+    bool readFromConnection(Connection &conn);
+#endif
+    // nullptr nếu đã đủ maxConnections (socket đã bị đóng)
+    ConnectionPtr registerConnection(SOCKET clientSocket, const std::string &clientIp);
+    void logRejectedConnection(const std::string &clientIp);
+    void removeConnection(const ConnectionPtr &conn);
+    // Client đã đóng nhưng còn request chờ xử lý: true nếu việc dọn dẹp được hoãn tới khi
+    // hàng đợi request cạn (processRequests sẽ đóng kết nối), false nếu phải dọn ngay
+    bool deferCloseUntilDrained(Connection &conn);
+    // Gỡ phiên của kết nối; expectedUserId != -1 thì chỉ gỡ nếu đúng người dùng đó.
+    // true nếu kết nối đã được gỡ khỏi phiên (người dùng có thể vẫn online ở kết nối khác)
+    bool unbindUser(Connection &conn, int expectedUserId = -1);
+    void queueRequests(const ConnectionPtr &conn, std::vector<QByteArray> &frames);
+    void processRequests(ConnectionPtr conn);
+    void dispatchRequest(Connection &conn, const QByteArray &data);
     void initDatabase();
 
     SOCKET serverSocket;
     QString m_serverIp;
     int m_serverPort;
-    std::vector<SOCKET> clientSockets;
-    std::mutex clientSocketsMutex;
+    // Các kết nối đang mở; chỉ bị khóa khi kết nối mở/đóng hoặc tra theo socket
+    ConnectionTable connections;
+    std::unique_ptr<WorkerPool> workerPool;
+    std::unique_ptr<WorkerPool> authPool;
+    std::unique_ptr<MessageWriter> messageWriter;
     static Server *m_instance;
-    std::map<QString, std::function<QJsonObject(const QJsonObject &, SOCKET)>> handlers;
-    std::map<int, SOCKET> userSockets;
-    std::mutex userSocketsMutex;
+    // Handler theo opcode, chỉ được ghi trong constructor
+    HandlerTable handlers;
+    // UserID -> các phiên đang online, thay cho map userSockets một phiên/người dùng
+    PresenceRegistry presence;
+    RateLimiter rateLimiter;
+    std::unique_ptr<FriendGraph> friendGraph;
+    std::unique_ptr<GroupCache> groupCache;
+    std::unique_ptr<SessionTokenStore> sessionTokens;
+    std::unique_ptr<PresenceNotifier> presenceNotifier;
+    std::unique_ptr<HeartbeatMonitor> heartbeat;
 };
 
 #endif // SERVER_H
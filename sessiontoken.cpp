@@ -0,0 +1,61 @@
+#include "sessiontoken.h"
+#include <QByteArray>
+#include <QRandomGenerator>
+#include <iterator>
+
+#define TOKEN_WORDS 8
+#define PRUNE_INTERVAL 1024
+
+SessionTokenStore::SessionTokenStore(std::chrono::minutes ttl)
+    : m_ttl(ttl)
+{}
+
+QString SessionTokenStore::issue(int userId)
+{
+    quint32 words[TOKEN_WORDS];
+    QRandomGenerator::system()->generate(std::begin(words), std::end(words));
+    QByteArray token = QByteArray(reinterpret_cast<const char *>(words), sizeof(words))
+                           .toBase64(QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals);
+
+    Clock::time_point now = Clock::now();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (++m_issuedSincePrune >= PRUNE_INTERVAL) {
+        pruneExpiredLocked(now);
+        m_issuedSincePrune = 0;
+    }
+    m_tokens[token.toStdString()] = {userId, now + m_ttl};
+    return QString::fromLatin1(token);
+}
+
+int SessionTokenStore::validate(const QString &token)
+{
+    Clock::time_point now = Clock::now();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_tokens.find(token.toStdString());
+    if (it == m_tokens.end()) {
+        return -1;
+    }
+    if (it->second.expiresAt <= now) {
+        m_tokens.erase(it);
+        return -1;
+    }
+    it->second.expiresAt = now + m_ttl;
+    return it->second.userId;
+}
+
+void SessionTokenStore::revoke(const QString &token)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_tokens.erase(token.toStdString());
+}
+
+void SessionTokenStore::pruneExpiredLocked(Clock::time_point now)
+{
+    for (auto it = m_tokens.begin(); it != m_tokens.end();) {
+        if (it->second.expiresAt <= now) {
+            it = m_tokens.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef SESSIONTOKEN_H
+#define SESSIONTOKEN_H
+
+#include <QString>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Token phiên cấp khi đăng nhập thành công, giữ trong bộ nhớ kèm thời hạn.
+// Client kết nối lại chỉ cần gửi token (resumeSession): tra cứu O(1), không
+// truy vấn database và không phải chạy lại PBKDF2. Token mất khi server khởi động lại,
+// lúc đó client đăng nhập lại bằng mật khẩu như bình thường.
+class SessionTokenStore
+{
+public:
+    explicit SessionTokenStore(std::chrono::minutes ttl);
+
+    SessionTokenStore(const SessionTokenStore &) = delete;
+    SessionTokenStore &operator=(const SessionTokenStore &) = delete;
+
+    // Tạo token ngẫu nhiên 256 bit cho userId
+    QString issue(int userId);
+    // UserID của token, -1 nếu không có hoặc đã hết hạn. Token hợp lệ được gia hạn thêm ttl.
+    int validate(const QString &token);
+    void revoke(const QString &token);
+
+    qint64 ttlSeconds() const { return std::chrono::duration_cast<std::chrono::seconds>(m_ttl).count(); }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Entry
+    {
+        int userId;
+        Clock::time_point expiresAt;
+    };
+
+    void pruneExpiredLocked(Clock::time_point now);
+
+    const std::chrono::minutes m_ttl;
+    std::mutex m_mutex;
+    std::unordered_map<std::string, Entry> m_tokens;
+    // Dọn token hết hạn sau mỗi một số lần cấp token, thay vì dùng luồng riêng
+    uint64_t m_issuedSincePrune = 0;
+};
+
+#endif // SESSIONTOKEN_H
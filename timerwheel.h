@@ -0,0 +1,92 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Timer wheel phân cấp: TIMER_WHEEL_LEVELS tầng, mỗi tầng 64 ô. Tầng 0 mỗi ô là một tick,
+// tầng k mỗi ô là 64^k tick. Thêm timer là O(1); khi tầng dưới quay hết một vòng,
+// ô tương ứng của tầng trên được rải xuống tầng dưới. Không có khóa, chủ sở hữu tự đồng bộ.
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_SLOT_BITS 6
+
+template<typename T>
+class TimerWheel
+{
+public:
+    uint64_t currentTick() const { return m_currentTick; }
+    size_t size() const { return m_size; }
+
+    // Hẹn value hết hạn ở tick deadline (sớm nhất là tick kế tiếp)
+    void schedule(uint64_t deadline, T value)
+    {
+        if (deadline <= m_currentTick) {
+            deadline = m_currentTick + 1;
+        }
+        place({deadline, std::move(value)});
+        ++m_size;
+    }
+
+    // Quay tới tick now, đưa các timer đã hết hạn vào expired
+    void advance(uint64_t now, std::vector<T> &expired)
+    {
+        while (m_currentTick < now) {
+            ++m_currentTick;
+            for (int level = 1; level < TIMER_WHEEL_LEVELS; ++level) {
+                if ((m_currentTick & ((uint64_t(1) << (TIMER_WHEEL_SLOT_BITS * level)) - 1)) != 0) {
+                    break;
+                }
+                std::vector<Entry> entries;
+                entries.swap(m_slots[level][slotIndex(m_currentTick, level)]);
+                for (Entry &entry : entries) {
+                    place(std::move(entry));
+                }
+            }
+
+            std::vector<Entry> &due = m_slots[0][slotIndex(m_currentTick, 0)];
+            for (Entry &entry : due) {
+                expired.push_back(std::move(entry.value));
+            }
+            m_size -= due.size();
+            due.clear();
+        }
+    }
+
+private:
+    static const size_t SLOT_COUNT = size_t(1) << TIMER_WHEEL_SLOT_BITS;
+
+    struct Entry
+    {
+        uint64_t deadline;
+        T value;
+    };
+
+    static size_t slotIndex(uint64_t tick, int level)
+    {
+        return static_cast<size_t>(tick >> (TIMER_WHEEL_SLOT_BITS * level)) & (SLOT_COUNT - 1);
+    }
+
+    // Chọn tầng thấp nhất còn chứa được khoảng cách tới deadline. Khi rải xuống,
+    // deadline có thể bằng đúng tick hiện tại: ô đó của tầng 0 được xử lý ngay sau.
+    void place(Entry entry)
+    {
+        const uint64_t maxDelta = (uint64_t(1) << (TIMER_WHEEL_SLOT_BITS * TIMER_WHEEL_LEVELS)) - 1;
+        if (entry.deadline - m_currentTick > maxDelta) {
+            entry.deadline = m_currentTick + maxDelta;
+        }
+        uint64_t delta = entry.deadline - m_currentTick;
+        int level = 0;
+        while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (uint64_t(1) << (TIMER_WHEEL_SLOT_BITS * (level + 1)))) {
+            ++level;
+        }
+        m_slots[level][slotIndex(entry.deadline, level)].push_back(std::move(entry));
+    }
+
+    std::vector<Entry> m_slots[TIMER_WHEEL_LEVELS][SLOT_COUNT];
+    uint64_t m_currentTick = 0;
+    size_t m_size = 0;
+};
+
+#endif // TIMERWHEEL_H
@@ -0,0 +1,97 @@
+#include "workerpool.h"
+#include <QDebug>
+
+WorkerPool::WorkerPool(const std::string &name, int threadCount, size_t maxQueued)
+    : m_name(name)
+    , m_maxQueued(maxQueued)
+{
+    m_threads.reserve(threadCount);
+    for (int i = 0; i < threadCount; ++i) {
+        m_threads.emplace_back(&WorkerPool::workerLoop, this);
+    }
+    qDebug() << "Worker pool" << QString::fromStdString(m_name) << "started with" << threadCount
+             << "threads.";
+}
+
+WorkerPool::~WorkerPool()
+{
+    shutdown();
+}
+
+void WorkerPool::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_cond.notify_all();
+    for (std::thread &thread : m_threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+}
+
+void WorkerPool::submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stopping) {
+            return;
+        }
+        m_tasks.push_back(std::move(task));
+    }
+    m_cond.notify_one();
+}
+
+bool WorkerPool::trySubmit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stopping) {
+            return false;
+        }
+        if (m_maxQueued > 0 && m_tasks.size() >= m_maxQueued) {
+            m_rejected.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        m_tasks.push_back(std::move(task));
+    }
+    m_cond.notify_one();
+    return true;
+}
+
+size_t WorkerPool::queueDepth() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_tasks.size();
+}
+
+int WorkerPool::threadCount() const
+{
+    return static_cast<int>(m_threads.size());
+}
+
+void WorkerPool::workerLoop()
+{
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait(lock, [this] { return m_stopping || !m_tasks.empty(); });
+            if (m_stopping && m_tasks.empty()) {
+                return;
+            }
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+
+        try {
+            task();
+        } catch (const std::exception &e) {
+            qDebug() << "Exception in worker pool" << QString::fromStdString(m_name) << ":" << e.what();
+        } catch (...) {
+            qDebug() << "Unknown exception in worker pool" << QString::fromStdString(m_name);
+        }
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Nhóm luồng cố định lấy việc từ một hàng đợi chung.
+// maxQueued > 0 giới hạn số việc chờ cho trySubmit (admission control).
+class WorkerPool
+{
+public:
+    WorkerPool(const std::string &name, int threadCount, size_t maxQueued = 0);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    // Chạy nốt các việc đã xếp hàng rồi dừng và join mọi luồng. Sau đó submit bị bỏ qua,
+    // trySubmit trả về false. Hủy WorkerPool cũng gọi hàm này.
+    void shutdown();
+
+    void submit(std::function<void()> task);
+    // Như submit nhưng từ chối (trả về false) khi hàng đợi đã đủ maxQueued việc
+    bool trySubmit(std::function<void()> task);
+
+    int threadCount() const;
+    // Số việc đang chờ trong hàng đợi (chưa tính việc đang chạy)
+    size_t queueDepth() const;
+    uint64_t rejectedCount() const { return m_rejected.load(std::memory_order_relaxed); }
+
+private:
+    void workerLoop();
+
+    std::string m_name;
+    std::vector<std::thread> m_threads;
+    std::deque<std::function<void()>> m_tasks;
+    const size_t m_maxQueued;
+    std::atomic<uint64_t> m_rejected{0};
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_stopping = false;
+};
+
+#endif // WORKERPOOL_H